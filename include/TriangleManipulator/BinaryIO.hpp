@@ -0,0 +1,258 @@
+#pragma once
+
+#ifndef BINARYIO_HPP_
+#define BINARYIO_HPP_
+
+#include "TriangleManipulator/TriangulateIOPool.hpp"
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace TriangleManipulator {
+    /**
+     * @brief How a binary_reader gets at the file.
+     * buffered: stdio, with an optional user sized buffer.
+     * mapped: the whole file is mapped once, and arrays can be handed out without copying.
+     */
+    enum class read_mode {
+        buffered,
+        mapped
+    };
+    /**
+     * @brief How a binary_writer gets data to disk.
+     * buffered: stdio, with an optional user sized buffer.
+     * direct: O_DIRECT where the filesystem supports it, through a page aligned buffer written in whole blocks.
+     */
+    enum class write_mode {
+        buffered,
+        direct
+    };
+
+    /**
+     * @brief A whole file mapped into memory, privately (copy on write). Shared between readers so arrays handed out stay valid.
+     */
+    struct file_mapping {
+        char* address;
+        size_t size;
+        file_mapping(char* address, size_t size) : address(address), size(size) {}
+        file_mapping(const file_mapping&) = delete;
+        file_mapping& operator=(const file_mapping&) = delete;
+        ~file_mapping();
+    };
+
+    /**
+     * @brief A class to write binary data to files. Throws std::runtime_error if the file can't be opened or a write comes up short.
+     */
+    class binary_writer {
+        private:
+            std::string filename;
+            FILE* file;
+            std::unique_ptr<char[]> stdio_buffer;
+            int descriptor;
+            std::unique_ptr<char, decltype(&std::free)> block_buffer;
+            size_t block_capacity;
+            size_t block_fill;
+            size_t written;
+            bool in_memory;
+            bool padded_arrays;
+            std::vector<char> memory;
+            void write_bytes(const void* data, size_t size);
+            void flush_blocks(bool final);
+            void pad_to(size_t alignment);
+        public:
+            /**
+             * @brief Construct a binary writer that collects everything in memory. See contents().
+             */
+            binary_writer();
+            /**
+             * @brief Construct a new binary writer object
+             *
+             * @param filename
+             * @param mode
+             * @param buffer_size Size of the write buffer in bytes. 0 keeps the stdio default in buffered mode, and uses 1MiB in direct mode.
+             */
+            binary_writer(const char* filename, write_mode mode = write_mode::buffered, size_t buffer_size = 0);
+            binary_writer(const binary_writer&) = delete;
+            binary_writer& operator=(const binary_writer&) = delete;
+            ~binary_writer();
+            /**
+             * @brief Write a value to file. Note: Uses copy constructor. Should only be used with Primitives and POD structures.
+             */
+            template<typename T>
+            inline void write(const T& arg) {
+                write_bytes(&arg, sizeof(T));
+            }
+            /**
+             * @brief Write what's at a pointer to file. Note: Does not use copy constructor. Should only be used with Primitives and POD structures.
+             */
+            template<typename T>
+            inline void write(const T* arg) {
+                write_bytes(arg, sizeof(T));
+            }
+
+            template<typename T>
+            inline void write_array(const T* arg, size_t length) {
+                if (padded_arrays) {
+                    pad_to(alignof(T));
+                }
+                write_bytes(arg, sizeof(T) * length);
+            }
+
+            template<typename T>
+            inline void write_array(std::shared_ptr<T[]> pointer, size_t length) {
+                write_array<T>(pointer.get(), length);
+            }
+            /**
+             * @brief Pad with zeros before each array so it starts aligned for its element type, relative to the start of the stream.
+             * The reader has to be told the same thing.
+             */
+            inline void pad_arrays(bool enabled) {
+                padded_arrays = enabled;
+            }
+            /**
+             * @brief Everything written so far by an in memory writer.
+             */
+            inline std::span<const char> contents() const {
+                return std::span<const char>(memory.data(), memory.size());
+            }
+            /**
+             * @brief Number of bytes written so far.
+             */
+            inline size_t tell() const {
+                return written;
+            }
+            /**
+             * @brief Close the file. Flushes it, and invalidates the writer. Does not automatically cleanup the buffer.
+             *
+             */
+            void close();
+    };
+    /**
+     * @brief A class to read files written using binary_writer. Throws std::runtime_error if the file can't be opened or a read comes up short.
+     */
+    class binary_reader {
+        private:
+            std::string filename;
+            FILE* file;
+            std::unique_ptr<char[]> stdio_buffer;
+            std::shared_ptr<const file_mapping> mapping;
+            const char* start;
+            const char* cursor;
+            const char* end;
+            bool padded_arrays;
+            void read_bytes(void* data, size_t size);
+            const char* take_bytes(size_t size);
+            inline void align_to(size_t alignment) {
+                if (padded_arrays) {
+                    skip((alignment - tell() % alignment) % alignment);
+                }
+            }
+            binary_reader(std::string filename, std::shared_ptr<const file_mapping> mapping, size_t offset, size_t length);
+        public:
+            /**
+             * @brief Construct a new binary reader object
+             *
+             * @param filename
+             * @param mode
+             * @param buffer_size Size of the read buffer in bytes, buffered mode only. 0 keeps the stdio default.
+             */
+            binary_reader(const char* filename, read_mode mode = read_mode::buffered, size_t buffer_size = 0);
+            binary_reader(binary_reader&& other) noexcept;
+            binary_reader(const binary_reader&) = delete;
+            binary_reader& operator=(const binary_reader&) = delete;
+            ~binary_reader();
+            /**
+             * @brief Read a value from file. Returns the value. Should only be used with Primitives and POD structures.
+             */
+            template<typename T>
+            inline T read() {
+                T value;
+                read_bytes(&value, sizeof(T));
+                return value;
+            }
+
+            /**
+             * @brief Read a value from file. Assigns the value to the reference argument. Should only be used with Primitives and POD structures.
+             */
+            template<typename T>
+            inline void read(T& arg) {
+                read_bytes(&arg, sizeof(T));
+            };
+
+            template<typename T>
+            inline void read(T* arg) {
+                read_bytes(arg, sizeof(T));
+            };
+
+            template<typename T>
+            inline void read_array(T* arg, size_t length) {
+                align_to(alignof(T));
+                read_bytes(arg, sizeof(T) * length);
+            }
+
+            /**
+             * @brief Read an array. When mapped and suitably aligned, the result points straight into the mapping (copy on write) and keeps it alive.
+             */
+            template<typename T>
+            inline std::shared_ptr<T[]> read_array(size_t length) {
+                align_to(alignof(T));
+                if (mapping && reinterpret_cast<std::uintptr_t>(cursor) % alignof(T) == 0) {
+                    T* data = reinterpret_cast<T*>(const_cast<char*>(take_bytes(sizeof(T) * length)));
+                    return std::shared_ptr<T[]>(mapping, data);
+                }
+                std::shared_ptr<T[]> pointer = allocate<T>(length);
+                read_bytes(pointer.get(), sizeof(T) * length);
+                return pointer;
+            }
+
+            /**
+             * @brief View an array in place. Only available in mapped mode, and only valid while this reader (or an array it handed out) is alive.
+             */
+            template<typename T>
+            inline std::span<const T> view_array(size_t length) {
+                align_to(alignof(T));
+                return std::span<const T>(reinterpret_cast<const T*>(take_bytes(sizeof(T) * length)), length);
+            }
+            /**
+             * @brief Skip over bytes without reading them.
+             */
+            void skip(size_t size);
+            /**
+             * @brief Expect the padding written by binary_writer::pad_arrays before each array.
+             */
+            inline void pad_arrays(bool enabled) {
+                padded_arrays = enabled;
+            }
+            inline bool pads_arrays() const {
+                return padded_arrays;
+            }
+            /**
+             * @brief The bytes this reader covers, in mapped mode.
+             */
+            inline std::span<const char> mapped_bytes() const {
+                return std::span<const char>(start, end);
+            }
+            /**
+             * @brief Offset of the next read from the start of the file, or the section in a sub reader.
+             */
+            size_t tell() const;
+            /**
+             * @brief A reader over [offset, offset + length) of this reader's mapping, which it shares. Mapped mode only.
+             */
+            binary_reader sub_reader(size_t offset, size_t length) const;
+            inline bool is_mapped() const {
+                return (bool) mapping;
+            }
+            /**
+             * @brief Close the file. Invalidates the reader. Does not automatically cleanup the buffer.
+             *
+             */
+            void close();
+    };
+}
+
+#endif /* BINARYIO_HPP_ */
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef HASH_HPP_
+#define HASH_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace TriangleManipulator {
+    /**
+     * @brief Fast non-cryptographic 64 bit hash (MurmurHash64A). Used for section checksums and cache keys.
+     *
+     * @param data
+     * @param size Length in bytes.
+     * @param seed Previous hash, to chain several buffers together.
+     */
+    inline std::uint64_t hash_bytes(const void* data, size_t size, std::uint64_t seed = 0) {
+        constexpr std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+        constexpr int r = 47;
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        std::uint64_t h = seed ^ (size * m);
+        const size_t blocks = size / 8;
+        for (size_t i = 0; i < blocks; i++) {
+            std::uint64_t k;
+            std::memcpy(&k, bytes + i * 8, 8);
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+            h ^= k;
+            h *= m;
+        }
+        const unsigned char* tail = bytes + blocks * 8;
+        switch (size & 7) {
+            case 7: h ^= std::uint64_t(tail[6]) << 48; [[fallthrough]];
+            case 6: h ^= std::uint64_t(tail[5]) << 40; [[fallthrough]];
+            case 5: h ^= std::uint64_t(tail[4]) << 32; [[fallthrough]];
+            case 4: h ^= std::uint64_t(tail[3]) << 24; [[fallthrough]];
+            case 3: h ^= std::uint64_t(tail[2]) << 16; [[fallthrough]];
+            case 2: h ^= std::uint64_t(tail[1]) << 8; [[fallthrough]];
+            case 1: h ^= std::uint64_t(tail[0]);
+                    h *= m;
+        }
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+        return h;
+    }
+
+    template<typename T>
+    inline std::uint64_t hash_array(const T* data, size_t length, std::uint64_t seed = 0) {
+        return hash_bytes(data, sizeof(T) * length, seed);
+    }
+
+    inline std::uint64_t hash_bytes(std::span<const char> bytes, std::uint64_t seed = 0) {
+        return hash_bytes(bytes.data(), bytes.size(), seed);
+    }
+}
+
+#endif /* HASH_HPP_ */
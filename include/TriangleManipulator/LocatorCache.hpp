@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef LOCATORCACHE_HPP_
+#define LOCATORCACHE_HPP_
+
+#include "TriangleManipulator/PointLocation.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace PointLocation {
+    /**
+     * @brief Everything besides the input arrays that changes what a locator build produces. Part of the cache key.
+     */
+    struct LocatorBuildOptions {
+        /**
+         * @brief Bumped whenever the build or the locator file layout changes, so stale entries are never handed out.
+         */
+        static constexpr std::uint32_t version = 2;
+        /**
+         * @brief Free form tag for anything the caller does differently between builds of the same input.
+         */
+        std::string tag;
+        /**
+         * @brief How a hit is loaded. Not part of the key.
+         */
+        load_mode mode = load_mode::full;
+    };
+
+    /**
+     * @brief On disk cache of built locators, keyed by a hash of the build inputs.
+     * A build is GraphInfo(input), process(), then map_triangles(mapped). Entries are mesh bundles with one checksummed graph_info section,
+     * written to a temporary file and renamed into place, so concurrent builders never see a partial entry.
+     * Entries that fail to open or fail their checksum are deleted and treated as misses.
+     */
+    class LocatorCache {
+        private:
+            std::filesystem::path directory;
+        public:
+            LocatorCache(std::filesystem::path directory);
+            /**
+             * @brief Hash of the input pointlist/segmentlist/trianglelist, the mapped trianglelist and the options.
+             */
+            static std::uint64_t key(std::shared_ptr<const triangulateio> input, std::shared_ptr<const triangulateio> mapped, const LocatorBuildOptions& options);
+            std::filesystem::path path_for(std::uint64_t key) const;
+            /**
+             * @brief The cached locator for key, or nullptr on a miss.
+             */
+            std::shared_ptr<GraphInfo> get(std::uint64_t key, load_mode mode = load_mode::full) const;
+            void put(std::uint64_t key, const GraphInfo& info) const;
+            /**
+             * @brief Return the cached locator for these inputs, building and storing it on a miss.
+             *
+             * @param input Passed to GraphInfo's constructor. Note that the build clears its holes, as it always has.
+             * @param mapped Passed to map_triangles.
+             * @param options
+             * @param hit Set to whether the cache had it, if not null.
+             */
+            std::shared_ptr<GraphInfo> get_or_build(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> mapped, const LocatorBuildOptions& options = LocatorBuildOptions(), bool* hit = nullptr) const;
+    };
+}
+
+#endif /* LOCATORCACHE_HPP_ */
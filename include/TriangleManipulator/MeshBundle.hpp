@@ -0,0 +1,119 @@
+#pragma once
+
+#ifndef MESHBUNDLE_HPP_
+#define MESHBUNDLE_HPP_
+
+#include "TriangleManipulator/TriangleManipulator.hpp"
+#include <cstdint>
+#include <optional>
+
+namespace TriangleManipulator {
+    /**
+     * @brief What a bundle section holds. Each one is laid out exactly like the matching *_file_binary file.
+     */
+    enum class section_type : std::uint32_t {
+        node = 1,
+        poly = 2,
+        ele = 3,
+        edge = 4,
+        neigh = 5,
+        graph_info = 6
+    };
+
+    /**
+     * @brief One entry of the section table. offset is from the start of the bundle, checksum is hash_bytes over the section.
+     */
+    struct bundle_section {
+        section_type type;
+        std::uint32_t reserved;
+        std::uint64_t offset;
+        std::uint64_t length;
+        std::uint64_t checksum;
+    };
+
+    /**
+     * @brief Fixed size record at the very end of a bundle, pointing at the section table.
+     * The table sits in front of it, so sections can be streamed out without knowing their sizes up front.
+     * The file also starts with the magic and version, so it can be recognised from its first bytes.
+     */
+    struct bundle_trailer {
+        std::uint64_t magic;
+        std::uint32_t version;
+        std::uint32_t section_count;
+        std::uint64_t table_offset;
+        std::uint64_t table_checksum;
+    };
+
+    constexpr std::uint64_t BUNDLE_MAGIC = 0x454c444e5542544dULL; // "MTBUNDLE"
+    constexpr std::uint32_t BUNDLE_VERSION = 1;
+    /**
+     * @brief Sections start on this boundary, so arrays inside them can be used straight out of the mapping.
+     */
+    constexpr size_t BUNDLE_SECTION_ALIGNMENT = 64;
+
+    /**
+     * @brief Writes a bundle, one section at a time. Each section is serialized in memory, checksummed, then appended.
+     */
+    class bundle_writer {
+        private:
+            binary_writer writer;
+            std::vector<bundle_section> sections;
+            bool closed;
+        public:
+            bundle_writer(const char* filename, write_mode mode = write_mode::buffered, size_t buffer_size = 0);
+            ~bundle_writer();
+            /**
+             * @brief Append a section. write is called with a binary_writer that pads arrays, and must write the whole section.
+             */
+            template<typename Func>
+            inline void add_section(section_type type, Func&& write) {
+                binary_writer section;
+                section.pad_arrays(true);
+                write(section);
+                add_section(type, section.contents());
+            }
+            void add_section(section_type type, std::span<const char> contents);
+            void add_node(std::shared_ptr<const triangulateio> out);
+            void add_poly(std::shared_ptr<const triangulateio> out);
+            void add_ele(std::shared_ptr<const triangulateio> out);
+            void add_edge(std::shared_ptr<const triangulateio> out);
+            void add_neigh(std::shared_ptr<const triangulateio> out);
+            /**
+             * @brief Write the section table and trailer, and close the file.
+             */
+            void close();
+    };
+
+    /**
+     * @brief A bundle opened for reading: one open, one mapping. Sections are only touched when asked for.
+     * Throws std::runtime_error if the file isn't a bundle, or a checksum doesn't match.
+     */
+    class mesh_bundle {
+        private:
+            binary_reader reader;
+            std::vector<bundle_section> table;
+        public:
+            mesh_bundle(const char* filename);
+            inline const std::vector<bundle_section>& sections() const {
+                return table;
+            }
+            std::optional<bundle_section> find(section_type type) const;
+            inline bool has(section_type type) const {
+                return find(type).has_value();
+            }
+            /**
+             * @brief A reader over one section. Arrays read from it alias the mapping. Throws if the section is missing.
+             *
+             * @param type
+             * @param verify Check the section checksum first. Costs one pass over the section.
+             */
+            binary_reader section(section_type type, bool verify = true) const;
+            void read_node(std::shared_ptr<triangulateio> in, bool verify = true) const;
+            void read_poly(std::shared_ptr<triangulateio> in, bool verify = true) const;
+            void read_ele(std::shared_ptr<triangulateio> in, bool verify = true) const;
+            void read_edge(std::shared_ptr<triangulateio> in, bool verify = true) const;
+            void read_neigh(std::shared_ptr<triangulateio> in, bool verify = true) const;
+    };
+}
+
+#endif /* MESHBUNDLE_HPP_ */
@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef NAVHIERARCHY_HPP_
+#define NAVHIERARCHY_HPP_
+
+#include "TriangleManipulator/Navigation.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace PointLocation {
+    /**
+     * @brief What building a NavHierarchy cost, split by phase. Times are in seconds.
+     */
+    struct HierarchyBuildStats {
+        size_t clusters;
+        size_t portals;
+        size_t abstract_edges;
+        double cluster_seconds;
+        double portal_seconds;
+        double cost_seconds;
+        double seconds;
+    };
+
+    /**
+     * @brief A two level graph over a NavMesh, for long path queries.
+     * Walkable triangles are grouped into connected clusters of roughly a given size. Each run of edges between the same two clusters is one
+     * portal, and the cost between every two portals of a cluster is found with a search inside it, ahead of time.
+     * A query searches that small graph for a route between portals, then refines only that route: one A* per leg, inside the cluster it crosses.
+     * Keeps a reference to the NavMesh, which has to outlive it. Queries are safe to run from several threads at once.
+     */
+    class NavHierarchy {
+        private:
+            struct Portal {
+                // One triangle on each side of the portal's edge, and the clusters they're in.
+                unsigned int triangles[2];
+                unsigned int clusters[2];
+                Vertex::Point middle;
+            };
+            struct AbstractEdge {
+                unsigned int to;
+                // The cluster the edge runs through.
+                unsigned int cluster;
+                double cost;
+            };
+            const NavMesh& mesh;
+            unsigned int cluster_triangles;
+            // Per triangle, its cluster, or -1 if it isn't walkable.
+            std::vector<unsigned int> clusters;
+            size_t cluster_total;
+            std::vector<Portal> portals;
+            // Per cluster, where its portals start in cluster_portals.
+            std::vector<unsigned int> cluster_portal_start;
+            std::vector<unsigned int> cluster_portals;
+            // Per portal, where its edges start in edges.
+            std::vector<unsigned int> edge_start;
+            std::vector<AbstractEdge> edges;
+            HierarchyBuildStats stats;
+            inline unsigned int portal_triangle(const Portal& portal, unsigned int cluster) const {
+                return portal.triangles[portal.clusters[1] == cluster];
+            }
+        public:
+            /**
+             * @brief Partition the mesh into clusters and build the abstract graph over their borders.
+             *
+             * @param mesh The mesh to build over.
+             * @param cluster_triangles Roughly how many triangles go in a cluster.
+             */
+            NavHierarchy(const NavMesh& mesh, unsigned int cluster_triangles = 256);
+            /**
+             * @brief Rebuild everything from the mesh, refreshing build_stats. Not safe to call while queries are running.
+             */
+            void rebuild();
+            inline const HierarchyBuildStats& build_stats() const {
+                return stats;
+            }
+            inline size_t cluster_count() const {
+                return cluster_total;
+            }
+            inline unsigned int cluster_of(unsigned int triangle) const {
+                return clusters[triangle];
+            }
+            /**
+             * @brief Like NavMesh::find_corridor, searching the abstract graph first. Start and goal in the same cluster are searched within it.
+             * Routes pass through each portal's middle edge, so corridors can be slightly longer than NavMesh's.
+             *
+             * @return Whether goal is reachable.
+             */
+            bool find_corridor(Vertex::Point start_point, unsigned int start, Vertex::Point goal_point, unsigned int goal, std::vector<unsigned int>& corridor) const;
+            /**
+             * @brief Like NavMesh::find_path, using find_corridor above.
+             */
+            bool find_path(Vertex::Point start, Vertex::Point goal, std::vector<Vertex::Point>& path) const;
+    };
+}
+
+#endif /* NAVHIERARCHY_HPP_ */
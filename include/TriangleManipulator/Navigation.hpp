@@ -0,0 +1,185 @@
+#pragma once
+
+#ifndef NAVIGATION_HPP_
+#define NAVIGATION_HPP_
+
+#include "TriangleManipulator/PointLocation.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace PointLocation {
+    /**
+     * @brief What NavMesh::segment_walk ran into.
+     */
+    struct SegmentWalk {
+        /**
+         * @brief Whether the walk was stopped before reaching the end point, or couldn't start.
+         */
+        bool hit;
+        /**
+         * @brief The last triangle the walk was in. Unset if the start point isn't on the mesh.
+         */
+        std::optional<unsigned int> triangle;
+        /**
+         * @brief The edge that stopped the walk, as vertex ids. Unset if it wasn't stopped by an edge.
+         */
+        std::optional<std::pair<unsigned int, unsigned int>> blocking_edge;
+    };
+
+    /**
+     * @brief A walkable mesh over a locator's base triangles, for pathfinding.
+     * A triangle is walkable if map_triangles mapped it. Agents can't cross out of walkable triangles, or across a constraint.
+     * Keeps a reference to the GraphInfo, which has to outlive it and have had map_triangles run.
+     */
+    class NavMesh {
+        private:
+            const GraphInfo& info;
+            // Per base triangle, in counter clockwise order.
+            std::vector<unsigned int> corners;
+            // Per triangle side, the walkable triangle across it, or -1 if it can't be crossed. Side i is opposite corner i.
+            std::vector<int> neighbors;
+            std::vector<Vertex::Point> centroids;
+            // Per triangle, how far its centroid is from the nearest wall.
+            std::vector<double> clearances;
+            // Walls are the sides that can't be crossed, as vertex ids, bucketed into a uniform grid of square cells.
+            std::vector<std::pair<unsigned int, unsigned int>> walls;
+            Vertex::Point wall_origin;
+            double wall_cell_size;
+            unsigned int wall_columns;
+            unsigned int wall_rows;
+            // Per cell, where its walls start in wall_cells. One past the last cell holds the total.
+            std::vector<unsigned int> wall_cell_start;
+            std::vector<unsigned int> wall_cells;
+            void build_walls();
+        public:
+            /**
+             * @brief Search state, reused across queries. Entries only count as set when their stamp matches the current generation,
+             * so starting a query never has to clear anything. Only grown, so repeated queries with the same buffers don't allocate.
+             */
+            struct SearchBuffers {
+                struct OpenEntry {
+                    double estimate;
+                    double cost;
+                    unsigned int triangle;
+                    constexpr bool operator>(const OpenEntry& rhs) const {
+                        return estimate > rhs.estimate;
+                    }
+                };
+                std::vector<std::uint32_t> stamp;
+                std::vector<double> cost;
+                std::vector<unsigned int> parent;
+                // Where the search entered each triangle: the middle of the side it came in through.
+                std::vector<Vertex::Point> position;
+                std::vector<OpenEntry> open;
+                std::vector<unsigned int> corridor;
+                // Distinct goals of a find_corridors search, sorted, and whether each has been settled yet.
+                std::vector<unsigned int> goals;
+                std::vector<char> settled;
+                std::uint32_t generation = 0;
+                inline void prepare(size_t triangles) {
+                    if (stamp.size() < triangles) {
+                        stamp.resize(triangles, 0);
+                        cost.resize(triangles);
+                        parent.resize(triangles);
+                        position.resize(triangles);
+                    }
+                    if (++generation == 0) {
+                        std::fill(stamp.begin(), stamp.end(), 0);
+                        generation = 1;
+                    }
+                    open.clear();
+                }
+            };
+            /**
+             * @brief Link the walkable base triangles across their sides, then build the wall grid and clearances.
+             *
+             * @param info A processed and mapped locator.
+             * @param constraints Optional. Its segmentlist, in the locator's vertex ids, marks edges that can't be crossed even between walkable triangles.
+             */
+            NavMesh(const GraphInfo& info, std::shared_ptr<const triangulateio> constraints = nullptr);
+            inline unsigned int triangle_count() const {
+                return centroids.size();
+            }
+            inline bool walkable(unsigned int triangle) const {
+                return info.triangle_map[triangle] != static_cast<unsigned int>(-1);
+            }
+            inline const unsigned int* triangle_corners(unsigned int triangle) const {
+                return corners.data() + triangle * 3;
+            }
+            inline int neighbor(unsigned int triangle, unsigned int side) const {
+                return neighbors[triangle * 3 + side];
+            }
+            inline const Vertex::Point& point(unsigned int vertex) const {
+                return info.planar_graph.vertices[vertex].point;
+            }
+            /**
+             * @brief How far the triangle's centroid is from the nearest wall: a constraint or a side leading out of the walkable area.
+             * Precomputed. Zero for triangles that aren't walkable, and infinity if there are no walls at all.
+             */
+            inline double clearance(unsigned int triangle) const {
+                return clearances[triangle];
+            }
+            /**
+             * @brief Distance from point to the nearest wall, searching outwards through the wall grid ring by ring.
+             *
+             * @param max_dist The search stops once nothing closer than this can be left.
+             * @return Infinity if there is no wall within max_dist.
+             */
+            double wall_distance(Vertex::Point point, double max_dist = INFINITY) const;
+            /**
+             * @brief The walkable base triangle containing point.
+             */
+            std::optional<unsigned int> locate(Vertex::Point point) const;
+            /**
+             * @brief A* over triangles from start to goal. Fills corridor with the triangles passed through, start first.
+             * Steps are measured between the midpoints of the sides crossed, from start_point and to goal_point.
+             * Search state lives in per thread buffers, unless the caller passes its own.
+             *
+             * @return Whether goal is reachable.
+             */
+            bool find_corridor(Vertex::Point start_point, unsigned int start, Vertex::Point goal_point, unsigned int goal, std::vector<unsigned int>& corridor) const;
+            bool find_corridor(Vertex::Point start_point, unsigned int start, Vertex::Point goal_point, unsigned int goal, std::vector<unsigned int>& corridor, SearchBuffers& buffers) const;
+            /**
+             * @brief find_corridor between two triangles' centroids.
+             */
+            bool find_corridor(unsigned int start, unsigned int goal, std::vector<unsigned int>& corridor) const;
+            /**
+             * @brief One Dijkstra search from start to several goals, for batches of queries sharing a start triangle.
+             * Steps are measured between side midpoints, from start_point. The search stops as soon as every goal has been settled.
+             * Corridor i is corridors[offsets[i]] up to corridors[offsets[i + 1]], and empty if goals[i] can't be reached.
+             *
+             * @param goals Goal triangles. Repeats are fine.
+             * @return How many goals were reached.
+             */
+            size_t find_corridors(Vertex::Point start_point, unsigned int start, std::span<const unsigned int> goals, std::vector<unsigned int>& corridors, std::vector<size_t>& offsets) const;
+            size_t find_corridors(Vertex::Point start_point, unsigned int start, std::span<const unsigned int> goals, std::vector<unsigned int>& corridors, std::vector<size_t>& offsets, SearchBuffers& buffers) const;
+            /**
+             * @brief Shortest waypoint path between two points, found with find_corridor then pulled tight with the funnel algorithm.
+             * path starts with start and ends with goal. Reuse path between calls to avoid allocating.
+             *
+             * @return Whether there is a path. path is left empty if not.
+             */
+            bool find_path(Vertex::Point start, Vertex::Point goal, std::vector<Vertex::Point>& path) const;
+            /**
+             * @brief Walk the straight line from a to b through adjacent triangles, stopping at the first edge that can't be crossed.
+             * Linear in the number of triangles crossed. A line through a vertex is stopped if either side of the triangle meeting there
+             * can't be crossed, so it can't slip past the corner where two walls meet.
+             *
+             * @param visited If not null, cleared and filled with the triangles walked through, in order.
+             */
+            SegmentWalk segment_walk(Vertex::Point a, Vertex::Point b, std::vector<unsigned int>* visited = nullptr) const;
+            inline bool line_of_sight(Vertex::Point a, Vertex::Point b) const {
+                return !segment_walk(a, b).hit;
+            }
+            /**
+             * @brief String pull a corridor from find_corridor into waypoints.
+             */
+            void pull_string(Vertex::Point start, Vertex::Point goal, std::span<const unsigned int> corridor, std::vector<Vertex::Point>& path) const;
+    };
+}
+
+#endif /* NAVIGATION_HPP_ */
@@ -0,0 +1,173 @@
+#pragma once
+
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace TriangleManipulator {
+    /**
+     * @brief Number of workers used by the parallel helpers. Never less than one.
+     */
+    inline unsigned int worker_count() {
+        const unsigned int hardware = std::thread::hardware_concurrency();
+        return hardware == 0 ? 1 : hardware;
+    }
+
+    /**
+     * @brief Number of chunks parallel_chunks will split count elements into. Useful for sizing per-chunk scratch space up front.
+     */
+    inline size_t chunk_count(size_t count, size_t min_chunk) {
+        if (count == 0) {
+            return 0;
+        }
+        min_chunk = std::max<size_t>(min_chunk, 1);
+        return std::clamp<size_t>(count / min_chunk + (count % min_chunk != 0), 1, worker_count());
+    }
+
+    /**
+     * @brief Split [0, count) into contiguous chunks and call func(chunk, begin, end) for each one. The first chunk runs on the calling thread.
+     * Chunks are never smaller than min_chunk, so small inputs never spawn threads.
+     *
+     * @return The number of chunks used, as reported by chunk_count.
+     */
+    template<typename Func>
+    inline size_t parallel_chunks(size_t count, size_t min_chunk, Func&& func) {
+        const size_t chunks = chunk_count(count, min_chunk);
+        if (chunks <= 1) {
+            if (count > 0) {
+                func(size_t(0), size_t(0), count);
+            }
+            return chunks;
+        }
+        const size_t step = (count + chunks - 1) / chunks;
+        std::vector<std::jthread> threads;
+        threads.reserve(chunks - 1);
+        for (size_t chunk = 1; chunk < chunks; chunk++) {
+            const size_t begin = std::min(chunk * step, count);
+            const size_t end = std::min(begin + step, count);
+            threads.emplace_back([&func, chunk, begin, end]() {
+                func(chunk, begin, end);
+            });
+        }
+        func(size_t(0), size_t(0), std::min(step, count));
+        return chunks;
+    }
+
+    /**
+     * @brief Like parallel_chunks, for work whose cost varies a lot from one index to the next. Calls func(worker, begin, end) on blocks of at most
+     * grain indices. Each worker starts with an even share of [0, count) and takes blocks off its front; once it runs dry, it steals the back half
+     * of whichever worker has the most left. Ranges are single atomic words, so neither side ever takes a lock.
+     *
+     * @return The number of workers used. Worker ids passed to func are below this, so it can index per worker scratch.
+     */
+    template<typename Func>
+    inline size_t parallel_steal(size_t count, size_t grain, Func&& func) {
+        grain = std::max<size_t>(grain, 1);
+        const size_t workers = chunk_count(count, grain);
+        if (workers <= 1 || count > UINT32_MAX) {
+            if (count > 0) {
+                for (size_t begin = 0; begin < count; begin += grain) {
+                    func(size_t(0), begin, std::min(begin + grain, count));
+                }
+            }
+            return std::min<size_t>(workers, 1);
+        }
+        // begin in the high half, end in the low half.
+        struct alignas(64) Range {
+            std::atomic<std::uint64_t> bounds;
+        };
+        const auto pack = [](std::uint64_t begin, std::uint64_t end) {
+            return (begin << 32) | end;
+        };
+        std::vector<Range> ranges(workers);
+        const size_t step = (count + workers - 1) / workers;
+        for (size_t worker = 0; worker < workers; worker++) {
+            ranges[worker].bounds = pack(std::min(worker * step, count), std::min((worker + 1) * step, count));
+        }
+        parallel_chunks(workers, 1, [&](size_t worker, size_t, size_t) {
+            std::atomic<std::uint64_t>& own = ranges[worker].bounds;
+            while (true) {
+                std::uint64_t bounds = own.load();
+                std::uint64_t begin = bounds >> 32, end = bounds & UINT32_MAX;
+                if (begin < end) {
+                    const std::uint64_t taken = std::min<std::uint64_t>(grain, end - begin);
+                    if (own.compare_exchange_weak(bounds, pack(begin + taken, end))) {
+                        func(worker, size_t(begin), size_t(begin + taken));
+                    }
+                    continue;
+                }
+                // Out of work, so steal. Work only ever moves out of non empty ranges, so once they're all empty, everything has been handed out.
+                size_t victim = workers;
+                std::uint64_t most = 0;
+                for (size_t other = 0; other < workers; other++) {
+                    const std::uint64_t other_bounds = ranges[other].bounds.load();
+                    const std::uint64_t left = (other_bounds & UINT32_MAX) - std::min(other_bounds >> 32, other_bounds & UINT32_MAX);
+                    if (left > most) {
+                        most = left;
+                        victim = other;
+                    }
+                }
+                if (victim == workers) {
+                    return;
+                }
+                std::uint64_t victim_bounds = ranges[victim].bounds.load();
+                begin = victim_bounds >> 32;
+                end = victim_bounds & UINT32_MAX;
+                if (begin >= end) {
+                    continue;
+                }
+                const std::uint64_t middle = end - (end - begin + 1) / 2;
+                if (ranges[victim].bounds.compare_exchange_strong(victim_bounds, pack(begin, middle))) {
+                    own.store(pack(middle, end));
+                }
+            }
+        });
+        return workers;
+    }
+
+    /**
+     * @brief Call func(i) for every i in [0, count), spread across workers.
+     */
+    template<typename Func>
+    inline void parallel_for(size_t count, size_t min_chunk, Func&& func) {
+        parallel_chunks(count, min_chunk, [&func](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                func(i);
+            }
+        });
+    }
+
+    /**
+     * @brief Sort a random access range by sorting chunks in parallel, then merging neighbouring runs pairwise.
+     */
+    template<typename Iterator, typename Compare = std::less<>>
+    inline void parallel_sort(Iterator first, Iterator last, Compare compare = Compare(), size_t min_chunk = 1 << 15) {
+        const size_t count = std::distance(first, last);
+        const size_t chunks = chunk_count(count, min_chunk);
+        if (chunks <= 1) {
+            std::sort(first, last, compare);
+            return;
+        }
+        const size_t step = (count + chunks - 1) / chunks;
+        parallel_chunks(count, min_chunk, [&](size_t, size_t begin, size_t end) {
+            std::sort(first + begin, first + end, compare);
+        });
+        for (size_t width = step; width < count; width *= 2) {
+            const size_t merges = (count + 2 * width - 1) / (2 * width);
+            parallel_for(merges, 1, [&](size_t merge) {
+                const size_t begin = merge * 2 * width;
+                const size_t middle = std::min(begin + width, count);
+                const size_t end = std::min(begin + 2 * width, count);
+                std::inplace_merge(first + begin, first + middle, first + end, compare);
+            });
+        }
+    }
+}
+
+#endif /* PARALLEL_HPP_ */
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef PATHENGINE_HPP_
+#define PATHENGINE_HPP_
+
+#include "TriangleManipulator/Navigation.hpp"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace PointLocation {
+    struct PathRequest {
+        Vertex::Point start;
+        Vertex::Point goal;
+    };
+
+    /**
+     * @brief What one PathEngine::find_paths call did, for the instrumentation hook. Times are in seconds.
+     */
+    struct PathBatchStats {
+        size_t requests;
+        size_t found;
+        /**
+         * @brief Distinct start triangles. Requests sharing one are answered from the same search.
+         */
+        size_t start_groups;
+        size_t workers;
+        double seconds;
+        double requests_per_second;
+        /**
+         * @brief Per request latency: from its group's search starting to its path being pulled.
+         * Only requests with both ends located count; 0 when there are none.
+         */
+        double p50_latency;
+        double p99_latency;
+    };
+
+    /**
+     * @brief The paths found by PathEngine::find_paths, in request order. Reuse one between calls to avoid allocating.
+     */
+    class PathBatch {
+        private:
+            friend class PathEngine;
+            struct Slot {
+                std::uint32_t worker;
+                bool found;
+                size_t offset;
+                size_t count;
+            };
+            std::vector<Slot> slots;
+            // Waypoints, one arena per worker so they never contend for it.
+            std::vector<std::vector<Vertex::Point>> arenas;
+        public:
+            inline size_t size() const {
+                return slots.size();
+            }
+            inline bool found(size_t request) const {
+                return slots[request].found;
+            }
+            /**
+             * @brief Waypoints for a request, start first and goal last, or empty if it had no path. Valid until the next find_paths into this batch.
+             */
+            inline std::span<const Vertex::Point> path(size_t request) const {
+                const Slot& slot = slots[request];
+                return { arenas[slot.worker].data() + slot.offset, slot.count };
+            }
+    };
+
+    /**
+     * @brief Answers batches of path queries over a NavMesh in parallel.
+     * Requests are grouped by start triangle, and a group with several goals is answered by one Dijkstra search that stops once all of them
+     * are settled, instead of one A* per goal. Groups are spread over workers with parallel_steal, since their costs vary wildly.
+     * Search state, corridors and waypoint arenas are kept per worker slot on the engine and the batch, so once they have grown, batches don't
+     * allocate for them. Each call still starts its worker threads afresh.
+     * Not safe to call find_paths on one engine from several threads at once; use an engine per thread for that.
+     */
+    class PathEngine {
+        private:
+            // Kept on the engine rather than per thread, since parallel_steal's workers are new threads every call.
+            struct WorkerScratch {
+                NavMesh::SearchBuffers search;
+                std::vector<unsigned int> goals;
+                std::vector<unsigned int> corridor;
+                std::vector<unsigned int> corridors;
+                std::vector<size_t> offsets;
+                std::vector<Vertex::Point> path;
+            };
+            const NavMesh& mesh;
+            std::vector<WorkerScratch> scratch;
+            std::vector<unsigned int> start_triangles;
+            std::vector<unsigned int> goal_triangles;
+            std::vector<std::uint32_t> order;
+            std::vector<size_t> groups;
+            std::vector<double> latencies;
+        public:
+            /**
+             * @brief Called after every find_paths with its stats. Latencies are only timed while this is set.
+             */
+            std::function<void(const PathBatchStats&)> on_batch;
+            /**
+             * @brief Groups with at least this many distinct goals share one Dijkstra search. Smaller ones run A* per goal.
+             */
+            size_t shared_search_goals = 3;
+            PathEngine(const NavMesh& mesh);
+            void find_paths(std::span<const PathRequest> requests, PathBatch& out);
+    };
+}
+
+#endif /* PATHENGINE_HPP_ */
@@ -5,8 +5,17 @@
 
 #include <triangle.h>
 #include "flat_multimap.hpp"
+#include "TriangleManipulator/SpatialOrder.hpp"
 #include <optional>
 #include <cmath>
+#include <span>
+
+namespace TriangleManipulator {
+    class binary_reader;
+    class binary_writer;
+    class bundle_writer;
+    class mesh_bundle;
+}
 
 namespace PointLocation {
     typedef double double64x2_t __attribute__((__vector_size__(16)));
@@ -188,23 +197,209 @@ namespace PointLocation {
         
         return ((ccw(a, b, c) == 0) ? true : ((ccw(a, b, c) > 0) ? (ccw(a, b, d) < 0) : (ccw(a, b, d) > 0))) && ((ccw(c, d, a) == 0) ? true : ((ccw(c, d, a) > 0) ? (ccw(c, d, b) < 0) : (ccw(c, d, b) > 0)));
     };
+    /**
+     * @brief What GraphInfo::read_from_binary_file materializes up front.
+     * full: everything.
+     * query_only: only what locate_point needs: the DAG, vertex positions, all_triangles and triangle_map.
+     * Vertex::neighs, Vertex::triangles and triangulations stay empty until load_topology() faults them in.
+     * process(), map_triangles() and writing do that themselves. Needs a mapped reader; a buffered one always loads in full.
+     */
+    enum class load_mode {
+        full,
+        query_only
+    };
+    struct DeferredTopology;
+    /**
+     * @brief What GraphInfo::nearest_located_triangle found.
+     */
+    struct NearestTriangle {
+        /**
+         * @brief The mapped id, like locate_point returns.
+         */
+        unsigned int triangle;
+        /**
+         * @brief The closest point of the triangle. The query point itself if it's inside.
+         */
+        Vertex::Point point;
+        double distance;
+    };
+    /**
+     * @brief One DAG edge in GraphInfo's query layout: a child triangle's corners, and where its own children's block starts.
+     * A cache line each, so testing a node's children reads consecutive lines and never goes back to all_triangles or the vertices.
+     */
+    struct alignas(64) QueryNode {
+        Vertex::Point corners[3];
+        unsigned int first_child;
+        // Zero for base triangles.
+        unsigned int child_count;
+        // The id in all_triangles.
+        unsigned int triangle;
+        // A deeper node on this one's most travelled path, tested before the children and jumped to if it contains the point. Zero for none.
+        unsigned int shortcut;
+    };
+    /**
+     * @brief How GraphInfo::build_query_layout orders the children blocks.
+     * breadth_first: level by level from the root.
+     * van_emde_boas: the top half of the levels first, then each subtree hanging below them, recursively, so any descent
+     * crosses few pages whatever the cache line and page sizes.
+     */
+    enum class query_layout {
+        breadth_first,
+        van_emde_boas
+    };
+    /**
+     * @brief How GraphInfo::order_children ranks a node's children, most likely first.
+     * frequency: by how many profiled descents took each child, then by area.
+     * area: by area, the chance of each child for queries spread evenly over the map.
+     */
+    enum class child_order {
+        frequency,
+        area
+    };
+    struct TrainingOptions {
+        child_order order = child_order::frequency;
+        /**
+         * @brief Whether to add shortcuts to the query layout, building one if there is none.
+         */
+        bool shortcuts = true;
+        /**
+         * @brief A shortcut skips down a path only while the replayed descents follow it at least this often.
+         */
+        double min_shortcut_probability = 0.5;
+        /**
+         * @brief Triangles passed by fewer descents than this don't get shortcuts.
+         */
+        size_t min_shortcut_visits = 16;
+    };
+    /**
+     * @brief What GraphInfo::train did, measured over the queries it was given.
+     */
+    struct TrainingStats {
+        size_t queries;
+        /**
+         * @brief Mean triangle tests per query before and after training.
+         */
+        double tests_before;
+        double tests_after;
+        size_t shortcuts;
+    };
     class GraphInfo {
+        private:
+            std::shared_ptr<const DeferredTopology> deferred;
+            // The root's own node first, then each node's children in one block. Empty until build_query_layout.
+            std::vector<QueryNode> query_nodes;
+            query_layout layout_kind;
+            size_t descent_tests(std::span<const Vertex::Point> queries) const;
+            size_t add_shortcuts(std::span<const Vertex::Point> queries, const TrainingOptions& options);
         public:
             PlanarGraph planar_graph;
             DirectedAcyclicGraph directed_graph;
             std::vector<unsigned int> triangle_map;
-            GraphInfo() : planar_graph(), directed_graph(), triangle_map() {};
-            GraphInfo(std::shared_ptr<triangulateio> input) : planar_graph(input), directed_graph(), triangle_map() {};
+            GraphInfo() : deferred(), query_nodes(), layout_kind(query_layout::van_emde_boas), planar_graph(), directed_graph(), triangle_map() {};
+            GraphInfo(std::shared_ptr<triangulateio> input) : deferred(), query_nodes(), layout_kind(query_layout::van_emde_boas), planar_graph(input), directed_graph(), triangle_map() {};
             void process();
             std::optional<unsigned int> locate_point(Vertex::Point point) const;
+            /**
+             * @brief locate_point for a batch. out[i] gets the mapped triangle containing points[i], or -1.
+             * With a query layout, each worker keeps group descents in flight and steps them in turn, prefetching a descent's next
+             * children block while it tests the others, so the walks wait on memory together instead of one after another.
+             * Without one, this is just locate_point in a parallel loop.
+             *
+             * @param out At least as long as points.
+             * @param group Descents in flight per worker, up to 64.
+             * @return How many points were found.
+             */
+            size_t locate_points(std::span<const Vertex::Point> points, std::span<unsigned int> out, unsigned int group = 8) const;
+            /**
+             * @brief The base triangle (an id below triangulations.front()) containing point, whether it's mapped or not.
+             */
+            std::optional<unsigned int> locate_base_triangle(Vertex::Point point) const;
+            /**
+             * @brief Every mapped triangle overlapping a rectangle, touching included, as mapped ids like locate_point returns.
+             * Descends the DAG, skipping children that miss the rectangle. out is cleared first; reuse it to avoid allocating.
+             *
+             * @return The number of triangles found.
+             */
+            size_t query_rectangle(double min_x, double min_y, double max_x, double max_y, std::vector<unsigned int>& out) const;
+            /**
+             * @brief Like query_rectangle, for a simple polygon given by its corners in either order. It may be concave.
+             */
+            size_t query_polygon(const std::vector<Vertex::Point>& polygon, std::vector<unsigned int>& out) const;
+            /**
+             * @brief The mapped triangle closest to point, for snapping points that locate_point misses back onto the mesh.
+             * Best first descent of the DAG, ordered by each node's distance to point, so only nodes closer than the answer are expanded.
+             *
+             * @param max_dist Triangles further away than this are ignored.
+             * @return Nothing if no mapped triangle is within max_dist.
+             */
+            std::optional<NearestTriangle> nearest_located_triangle(Vertex::Point point, double max_dist = INFINITY) const;
             inline bool triangle_contains_point(const Vertex::Point& p, const Triangle& tri) const {
                 const auto& vertices = this->planar_graph.vertices;
                 return point_inside_triangle(p, vertices[tri.vertex_one].point, vertices[tri.vertex_two].point, vertices[tri.vertex_three].point);
             };
             void map_triangles(std::shared_ptr<triangulateio> others);
+            /**
+             * @brief Renumber the triangles level by level through the DAG, along a curve through their centroids within each level,
+             * so DAG descents and walks over neighbours stay in nearby memory. Base triangles keep ids below triangulations.front() and the root stays last. triangle_map, the DAG and Vertex::triangles follow.
+             * Run after process(). Vertices keep their ids; reorder the input with TriangleManipulator::reorder_points before building for that.
+             */
+            void reorder(TriangleManipulator::space_filling_curve curve = TriangleManipulator::space_filling_curve::hilbert);
+            /**
+             * @brief Copy the DAG into a flat layout that locate_point and everything built on it descend instead.
+             * Each node's children sit in one block with their corners, at the cost of 64 bytes per DAG edge.
+             * Ids, root and triangle_map are untouched. process(), reorder() and reading drop the layout; build it again after them.
+             */
+            void build_query_layout(query_layout layout = query_layout::van_emde_boas);
+            inline bool has_query_layout() const {
+                return !query_nodes.empty();
+            }
+            /**
+             * @brief Replay queries down the DAG, counting how many descents take each edge. Indexed like directed_graph.graph.
+             */
+            std::vector<size_t> profile_descents(std::span<const Vertex::Point> queries) const;
+            /**
+             * @brief Sort each node's children so the likeliest are tested first. Only a point on an edge shared by two children can get a different, equally valid, triangle.
+             * Rebuilds the query layout if there is one, which drops its shortcuts.
+             *
+             * @param edge_counts From profile_descents. Only used for child_order::frequency.
+             */
+            void order_children(child_order order, std::span<const size_t> edge_counts = {});
+            /**
+             * @brief Tune the locator to a query log: order children by how often the log takes them, then give the query layout shortcuts
+             * down the paths the log mostly follows. Worth it when queries crowd into a few areas.
+             */
+            TrainingStats train(std::span<const Vertex::Point> queries, const TrainingOptions& options = TrainingOptions());
             void write_to_binary_file(std::string filename) const;
-            void read_from_binary_file(std::string filename);
+            void write_to_binary(TriangleManipulator::binary_writer& writer) const;
+            void write_to_bundle(TriangleManipulator::bundle_writer& bundle) const;
+            void read_from_binary_file(std::string filename, load_mode mode = load_mode::full);
+            void read_from_binary(TriangleManipulator::binary_reader& reader, load_mode mode = load_mode::full);
+            void read_from_bundle(const TriangleManipulator::mesh_bundle& bundle, bool verify = true, load_mode mode = load_mode::full);
+            /**
+             * @brief Fault in whatever a load_mode::query_only load skipped. Does nothing otherwise.
+             */
+            void load_topology();
+            inline bool topology_loaded() const {
+                return !deferred;
+            }
+    };
+    /**
+     * @brief What benchmark_locate measured.
+     */
+    struct LocateBenchmark {
+        size_t queries;
+        size_t found;
+        double seconds;
+        double queries_per_second;
+        /**
+         * @brief Mean distance in bytes between consecutive triangles read during a descent. A hardware independent stand in for cache misses.
+         */
+        double mean_stride;
     };
+    /**
+     * @brief Time locate_point over a set of points, for comparing layouts such as before and after GraphInfo::reorder.
+     */
+    LocateBenchmark benchmark_locate(const GraphInfo& info, std::span<const Vertex::Point> points);
     inline constexpr void sort(unsigned int& a, unsigned int& b, unsigned int& c) {
         if (a < b) {
             std::swap(a, b);
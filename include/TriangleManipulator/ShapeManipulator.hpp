@@ -4,7 +4,9 @@
 #define SHAPEMANIPULATOR_HPP_
 
 #include "TriangleManipulator/PointLocation.hpp"
+#include "TriangleManipulator/SweepLine.hpp"
 #include <functional>
+#include <optional>
 #include <set>
 
 inline bool intersects(const PointLocation::Line& line_one, const PointLocation::Line& line_two) {
@@ -68,28 +70,61 @@ namespace ShapeManipulator {
     inline std::shared_ptr<std::vector<double>> find_points_inside(std::shared_ptr<std::vector<PointLocation::Line>> object) {
         return find_points_inside(*object);
     };
+    /**
+     * @brief One point inside every region enclosed by segments that isn't already a hole. Triangulates once and flood fills across non-segment edges.
+     */
     std::shared_ptr<std::vector<double>> find_points_inside(std::shared_ptr<triangulateio> input);
+    /**
+     * @brief What simplify_lines changed. Triangle counts are only filled in when asked for, as that costs two triangulations.
+     */
+    struct SimplifyReport {
+        size_t points_before;
+        size_t points_after;
+        size_t segments_before;
+        size_t segments_after;
+        std::optional<size_t> triangles_before;
+        std::optional<size_t> triangles_after;
+    };
+    /**
+     * @brief Merge collinear lines that overlap or touch end to end into one, and drop duplicates and zero length lines. Run before from_list.
+     * Exact: lines are grouped by reduced direction and offset, and merged as integer intervals along it.
+     * Lines that only touch at a point where a line in another direction ends are left apart, as that vertex stays in the triangulation anyway.
+     *
+     * @param lines Simplified in place. Order isn't kept.
+     * @param count_triangles Also triangulate before and after, to report the triangle counts.
+     */
+    SimplifyReport simplify_lines(std::vector<PointLocation::Line>& lines, bool count_triangles = false);
+    /**
+     * @brief Two lines that meet, and where. first < second, as indices into the input.
+     */
+    struct SegmentIntersection {
+        std::uint32_t first;
+        std::uint32_t second;
+        double x;
+        double y;
+    };
+    /**
+     * @brief Bentley-Ottmann sweep over lines at any angle, O((n + k) log n). All predicates are exact.
+     * Lines that share an end point count as meeting there. A pair of overlapping collinear lines is reported at each end of the overlap.
+     */
+    std::vector<SegmentIntersection> find_intersections(const std::vector<PointLocation::Line>& lines);
+    /**
+     * @brief Split every line wherever it meets another, so the result only touches at end points. Run before from_list.
+     * Crossings are rounded to the nearest grid point, repeating until that introduces no new crossings. Duplicate and zero length pieces are dropped.
+     * Throws std::runtime_error if the rounding hasn't settled after 64 passes, rather than return lines that still cross.
+     */
+    std::vector<PointLocation::Line> split_intersections(const std::vector<PointLocation::Line>& lines);
+    /**
+     * @brief Call callback(first, second) for every pair of intersecting axis aligned lines. See for_each_axis_intersection.
+     */
+    template<typename Callback>
+    inline void handle_intersections(const std::vector<PointLocation::Line>& lines, Callback&& callback) {
+        for_each_axis_intersection(lines, [&lines, &callback](std::uint32_t first, std::uint32_t second) {
+            callback(lines[first], lines[second]);
+        });
+    }
     inline void handle_intersections(std::vector<PointLocation::Line>& lines, std::function<void(const PointLocation::Line&, const PointLocation::Line&)> callback) {
-        std::set<Point_Marker> points = std::set<Point_Marker>();
-        const PointLocation::Line* lines_ptr = lines.data();
-        for (size_t i = 0, size = lines.size(); i < size; i++) {
-            const PointLocation::Line& line = *lines_ptr++;
-            points.emplace(line.first, i, BEGIN);
-            points.emplace(line.second, i, END);
-        }
-        std::set<short> beginnings = std::set<short>();
-        for (const Point_Marker& first : points) {
-            if (first.marker == BEGIN) {
-                beginnings.insert(first.line);
-                continue;
-            }
-            beginnings.erase(first.line);
-            for (const short other_line : beginnings) {
-                if (intersects(lines[first.line], lines[other_line])) {
-                    callback(lines[first.line], lines[other_line]);
-                }
-            }
-        }
+        handle_intersections(std::as_const(lines), callback);
     }
 }
 
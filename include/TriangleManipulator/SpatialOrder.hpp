@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef SPATIAL_ORDER_HPP_
+#define SPATIAL_ORDER_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+#include <triangle.h>
+
+namespace TriangleManipulator {
+    /**
+     * @brief Curves for numbering things so that ids close together are close together in space.
+     * Hilbert keeps neighbours closer; Morton is cheaper to compute.
+     */
+    enum class space_filling_curve {
+        hilbert,
+        morton
+    };
+
+    /**
+     * @brief Position along the curve of a point on a 2^32 by 2^32 grid.
+     */
+    std::uint64_t curve_key(std::uint32_t x, std::uint32_t y, space_filling_curve curve);
+    /**
+     * @brief Indices of count points, as x y pairs, sorted along the curve over their bounding box. Ties keep their input order.
+     */
+    std::vector<unsigned int> spatial_order(const REAL* points, size_t count, space_filling_curve curve = space_filling_curve::hilbert);
+    /**
+     * @brief Renumber a mesh's points along the curve, carrying attributes and markers, and rewrite its triangles, segments and edges to match.
+     * Meant to run before triangulate, so everything built from the mesh inherits the order. Everything else is copied as is, and output may be input.
+     *
+     * @return The new id of each old point, for renumber_points on other meshes over the same points.
+     */
+    std::vector<unsigned int> reorder_points(std::shared_ptr<const triangulateio> input, std::shared_ptr<triangulateio> output, space_filling_curve curve = space_filling_curve::hilbert);
+    /**
+     * @brief Rewrite a mesh's triangles, segments and edges in place through point_map, leaving its points alone.
+     */
+    void renumber_points(std::shared_ptr<triangulateio> mesh, std::span<const unsigned int> point_map);
+}
+
+#endif /* SPATIAL_ORDER_HPP_ */
@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef SWEEPLINE_HPP_
+#define SWEEPLINE_HPP_
+
+#include "TriangleManipulator/PointLocation.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include "flat_multimap.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace ShapeManipulator {
+    /**
+     * @brief A sweep event. Events are ordered by x, then kind, so horizontals that touch a vertical at its x are still open when it's tested.
+     */
+    struct SweepEvent {
+        enum Kind : std::uint8_t {
+            HORIZONTAL_BEGIN = 0,
+            VERTICAL = 1,
+            HORIZONTAL_END = 2
+        };
+        short x;
+        // Lower y for verticals, the y of the line for horizontals.
+        short y;
+        Kind kind;
+        std::uint32_t line;
+        constexpr bool operator<(const SweepEvent& rhs) const {
+            return (x < rhs.x) || (x == rhs.x && (kind < rhs.kind || (kind == rhs.kind && y < rhs.y)));
+        }
+    };
+
+    /**
+     * @brief Report every intersecting pair of axis aligned lines, as callback(first_index, second_index), each pair once.
+     * Intersections are inclusive of end points, the same as intersects(). Lines that are neither horizontal nor vertical are skipped.
+     * Sweeps left to right over a flat sorted event list; open horizontals are kept keyed by their y, so each vertical only looks at the
+     * horizontals in its y range. O(n log n + n * h + k) for n lines, at most h horizontals open at once and k reported pairs, with
+     * overlapping collinear runs counting towards k. The n * h is the flat map shifting on insert and erase, which for the short open
+     * sets of map outlines is cheaper than a tree's node allocations; a few thousand long horizontals open together would make it dominate.
+     */
+    template<typename Callback>
+    inline void for_each_axis_intersection(const std::vector<PointLocation::Line>& lines, Callback&& callback) {
+        std::vector<SweepEvent> events;
+        events.reserve(lines.size() * 2);
+        for (std::uint32_t i = 0, size = lines.size(); i < size; i++) {
+            const PointLocation::Line& line = lines[i];
+            if (line.x1 == line.x2) {
+                events.push_back({ line.x1, std::min(line.y1, line.y2), SweepEvent::VERTICAL, i });
+            } else if (line.y1 == line.y2) {
+                events.push_back({ std::min(line.x1, line.x2), line.y1, SweepEvent::HORIZONTAL_BEGIN, i });
+                events.push_back({ std::max(line.x1, line.x2), line.y1, SweepEvent::HORIZONTAL_END, i });
+            }
+        }
+        TriangleManipulator::parallel_sort(events.begin(), events.end());
+
+        // A sorted vector, so emplace and erase are linear in the open count. Finding a horizontal to close only scans lines on its y,
+        // all of which overlap it and were reported, so that part is paid for by k.
+        flat_multimap<short, std::uint32_t> open_horizontals;
+        // Verticals on the current x that can still overlap the next one, as (upper y, line).
+        std::vector<std::pair<short, std::uint32_t>> open_verticals;
+        short verticals_x = 0;
+        for (const SweepEvent& event : events) {
+            switch (event.kind) {
+                case SweepEvent::HORIZONTAL_BEGIN: {
+                    // Anything open on the same y overlaps this one.
+                    auto [first, last] = open_horizontals.equal_range(event.y);
+                    for (auto current = first; current != last; current++) {
+                        callback(current->second, event.line);
+                    }
+                    open_horizontals.emplace(event.y, event.line);
+                    break;
+                }
+                case SweepEvent::HORIZONTAL_END: {
+                    auto [first, last] = open_horizontals.equal_range(event.y);
+                    for (auto current = first; current != last; current++) {
+                        if (current->second == event.line) {
+                            open_horizontals.erase(current);
+                            break;
+                        }
+                    }
+                    break;
+                }
+                case SweepEvent::VERTICAL: {
+                    const PointLocation::Line& line = lines[event.line];
+                    const short top = std::max(line.y1, line.y2);
+                    for (auto current = open_horizontals.lower_bound(event.y), last = open_horizontals.upper_bound(top); current != last; current++) {
+                        callback(current->second, event.line);
+                    }
+                    // Verticals arrive sorted by lower y within an x, so only the ones reaching this far down can overlap it.
+                    if (open_verticals.empty() || verticals_x != event.x) {
+                        open_verticals.clear();
+                        verticals_x = event.x;
+                    }
+                    std::erase_if(open_verticals, [&event](const std::pair<short, std::uint32_t>& open) {
+                        return open.first < event.y;
+                    });
+                    for (const std::pair<short, std::uint32_t>& open : open_verticals) {
+                        callback(open.second, event.line);
+                    }
+                    open_verticals.emplace_back(top, event.line);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+#endif /* SWEEPLINE_HPP_ */
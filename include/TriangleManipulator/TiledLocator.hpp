@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef TILEDLOCATOR_HPP_
+#define TILEDLOCATOR_HPP_
+
+#include "TriangleManipulator/PointLocation.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace PointLocation {
+    /**
+     * @brief A triangle of one tile's mesh.
+     */
+    struct TileLocation {
+        std::uint32_t tile;
+        unsigned int triangle;
+    };
+
+    /**
+     * @brief One tile: its bounds, the constraints clipped to it, its mesh and the locator over that mesh.
+     */
+    struct Tile {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+        std::shared_ptr<triangulateio> input;
+        std::shared_ptr<triangulateio> mesh;
+        GraphInfo locator;
+    };
+
+    struct TiledBuildOptions {
+        /**
+         * @brief Width and height of a tile.
+         */
+        short tile_size = 1024;
+        /**
+         * @brief Passed to triangulate for each tile's mesh. Switches that add vertices (q, a, u, D, o) are rejected, since each tile's locator
+         * is built over the input points alone and couldn't map the mesh's triangles.
+         */
+        const char* switches = "pzQ";
+        /**
+         * @brief Hole points, x and y interleaved. Each one's region is found over the whole map, so it is left out of every tile it reaches.
+         */
+        std::vector<double> holes;
+    };
+
+    /**
+     * @brief Splits a map into a grid of tiles and builds a mesh and locator for each one in parallel.
+     * Lines are clipped to every tile they cross, and each tile gets its border as constraints. Neighbouring tiles swap the vertices on
+     * their shared border before triangulating, so both meshes end up with exactly the same vertices along it.
+     * The tiles leave out what a single mesh of the map would: the outside of its outline and the regions of its holes. Those are found by
+     * triangulating every tile's pieces together once, and each tile gets a hole point in every part of them it covers.
+     * Queries find their tile first, then descend that tile's locator.
+     * Clipping, splitting and building the locator DAGs run in parallel. Triangle keeps process wide state, so the triangulate calls are
+     * serialized behind one lock; other threads shouldn't call triangulate while tiles are being built.
+     */
+    class TiledLocator {
+        private:
+            int origin_x;
+            int origin_y;
+            int tile_size;
+            std::uint32_t columns;
+            std::uint32_t rows;
+            std::vector<Tile> tile_list;
+        public:
+            TiledLocator(const std::vector<Line>& lines, const TiledBuildOptions& options = TiledBuildOptions());
+            inline const std::vector<Tile>& tiles() const {
+                return tile_list;
+            }
+            /**
+             * @brief The tile a point falls in, or nullopt if it's outside the map's bounds.
+             */
+            std::optional<std::uint32_t> tile_index(Vertex::Point point) const;
+            std::optional<TileLocation> locate_point(Vertex::Point point) const;
+    };
+}
+
+#endif /* TILEDLOCATOR_HPP_ */
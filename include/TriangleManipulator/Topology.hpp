@@ -0,0 +1,66 @@
+#pragma once
+
+#ifndef TOPOLOGY_HPP_
+#define TOPOLOGY_HPP_
+
+#include "TriangleManipulator/TriangleManipulator.hpp"
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace TriangleManipulator {
+    /**
+     * @brief Edges and adjacency derived from nothing but a triangle list, so Triangle doesn't have to be asked for them.
+     */
+    struct MeshTopology {
+        /**
+         * @brief Each edge once, as vertex ids with the smaller first, sorted.
+         */
+        std::vector<unsigned int> edges;
+        /**
+         * @brief Per edge, a triangle side lying on it: side edge_sides[e] % 3 of triangle edge_sides[e] / 3.
+         * The triangle on its other side, if any, is neighbors[edge_sides[e]].
+         */
+        std::vector<unsigned int> edge_sides;
+        /**
+         * @brief Per triangle side, the triangle across it, or -1. Side i is opposite corner i, like Triangle's neighborlist.
+         */
+        std::vector<int> neighbors;
+        /**
+         * @brief Per vertex, where its triangles start in vertex_triangles. One past the last vertex holds the total.
+         */
+        std::vector<unsigned int> vertex_triangle_start;
+        std::vector<unsigned int> vertex_triangles;
+        inline size_t edge_count() const {
+            return edge_sides.size();
+        }
+        inline bool boundary(size_t edge) const {
+            return neighbors[edge_sides[edge]] < 0;
+        }
+        /**
+         * @brief The triangles using a vertex, in ascending order.
+         */
+        inline std::span<const unsigned int> triangles_around(unsigned int vertex) const {
+            return std::span<const unsigned int>(vertex_triangles).subspan(vertex_triangle_start[vertex], vertex_triangle_start[vertex + 1] - vertex_triangle_start[vertex]);
+        }
+    };
+
+    /**
+     * @brief Sort every triangle side by its packed vertex pair in parallel, then read edges and neighbors off runs of equal keys.
+     * Orientation doesn't matter. Where more than two triangles share an edge, only the first two are made neighbors.
+     *
+     * @param triangles Three zero based corners per triangle, all below vertex_count.
+     */
+    MeshTopology build_topology(const unsigned int* triangles, size_t triangle_count, size_t vertex_count);
+    /**
+     * @brief build_topology over a mesh's trianglelist. Throws std::runtime_error for second order (o2) meshes.
+     */
+    MeshTopology build_topology(std::shared_ptr<const triangulateio> mesh);
+    /**
+     * @brief Fill in a mesh's edgelist, edgemarkerlist and neighborlist, as Triangle's e and n switches would.
+     * Boundary edges are marked 1 and the rest 0, as Triangle does without segments.
+     */
+    void add_topology(std::shared_ptr<triangulateio> mesh);
+}
+
+#endif /* TOPOLOGY_HPP_ */
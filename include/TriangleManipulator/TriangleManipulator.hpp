@@ -3,119 +3,27 @@
 #ifndef TRIANGLEMANIPULATOR_HPP_
 #define TRIANGLEMANIPULATOR_HPP_
 
+#include <cstdint>
 #include <functional>
+#include <span>
+#include <type_traits>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include "fmt/os.h"
+#include "TriangleManipulator/BinaryIO.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include "TriangleManipulator/TriangulateIOPool.hpp"
 #include <triangle.h>
 
 namespace TriangleManipulator {
     /**
-     * @brief A class to write binary data to files.
+     * @brief A new, empty triangulateio. Recycled from the current thread's TriangulateIOPool if there is one.
      */
-    class binary_writer {
-        private:
-            FILE* file;
-        public:
-            /**
-             * @brief Construct a new binary writer object
-             * 
-             * @param filename 
-             */
-            binary_writer(const char* filename) {
-                file = std::fopen(filename, "wb");
-            };
-            /**
-             * @brief Write a value to file. Note: Uses copy constructor. Should only be used with Primitives and POD structures.
-             */
-            template<typename T>
-            inline void write(const T& arg) {
-                std::fwrite(&arg, sizeof(T), 1, file);
-            }
-            /**
-             * @brief Write what's at a pointer to file. Note: Does not use copy constructor. Should only be used with Primitives and POD structures.
-             */
-            template<typename T>
-            inline void write(const T* arg) {
-                std::fwrite(arg, sizeof(T), 1, file);
-            }
-
-            template<typename T>
-            inline void write_array(const T* arg, size_t length) {
-                std::fwrite(arg, sizeof(T), length, file);
-            }
-
-            template<typename T>
-            inline void write_array(std::shared_ptr<T[]> pointer, size_t length) {
-                std::fwrite(pointer.get(), sizeof(T), length, file);
-            }
-            /**
-             * @brief Close the file. Flushes it, and invalidates the writer. Does not automatically cleanup the buffer.
-             * 
-             */
-            inline void close() {
-                std::fclose(file);
-            }
-    };
-    /**
-     * @brief A class to read files written using binary_writer.
-     */
-    class binary_reader {
-        private:
-            FILE* file;
-        public:
-            /**
-             * @brief Construct a new binary reader object
-             * 
-             * @param filename 
-             */
-            binary_reader(const char* filename) {
-                file = std::fopen(filename, "rb");
-            };
-            /**
-             * @brief Read a value from file. Returns the value. Should only be used with Primitives and POD structures.
-             */
-            template<typename T>
-            inline T read() {
-                T value;
-                std::fread(&value, sizeof(T), 1, file);
-                return value;
-            }
-
-            /**
-             * @brief Read a value from file. Assigns the value to the reference argument. Should only be used with Primitives and POD structures.
-             */
-            template<typename T>
-            inline void read(T& arg) {
-                std::fread(&arg, sizeof(T), 1, file);
-            };
-            
-            template<typename T>
-            inline void read(T* arg) {
-                std::fread(arg, sizeof(T), 1, file);
-            };
-            
-            template<typename T>
-            inline void read_array(T* arg, size_t length) {
-                std::fread(arg, sizeof(T), length, file);
-            }
-
-            template<typename T>
-            inline std::shared_ptr<T[]> read_array(size_t length) {
-                std::shared_ptr<T[]> pointer = std::make_shared_for_overwrite<T[]>(length);
-                std::fread(pointer.get(), sizeof(T), length, file);
-                return pointer;
-            }
-            /**
-             * @brief Close the file. Invalidates the reader. Does not automatically cleanup the buffer.
-             * 
-             */
-            inline void close() {
-                std::fclose(file);
-            }
-    };
     inline std::shared_ptr<triangulateio> create_instance() {
+        if (TriangulateIOPool* pool = TriangulateIOPool::current()) {
+            return pool->create_instance();
+        }
         std::shared_ptr<triangulateio> res = std::make_shared<triangulateio>();//std::shared_ptr<triangulateio>(new triangulateio());
         res->pointlist = nullptr;
         res->pointattributelist = nullptr;
@@ -149,38 +57,201 @@ namespace TriangleManipulator {
         return res;
     }
     void report(std::shared_ptr<triangulateio> io, int markers, int reporttriangles, int reportneighbors, int reportsegments, int reportedges, int reportnorms);
-    inline void filter_edges(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, std::function<bool(const int&, const int& , const double&, const double&)> predicate) {
-        const size_t edges = input->numberofedges;
-        const bool markers = input->edgemarkerlist != nullptr;
-        const int* edges_ptr = input->edgelist.get();
-        const REAL* norms_ptr = input->normlist.get();
-        const int* markers_ptr = input->edgemarkerlist.get();
-        
-        output->edgelist = trimalloc<int>(edges * 2);
-        output->normlist = trimalloc<REAL>(edges * 2);
-        if (markers) {
-            output->edgemarkerlist = trimalloc<int>(edges);
+    /**
+     * @brief How many records each filtering task flags and copies.
+     */
+    constexpr size_t FILTER_CHUNK = 1 << 15;
+
+    /**
+     * @brief Two pass parallel compaction of count records. mask(begin, end, flags) sets flags[i] for every i in [begin, end) to whether
+     * record i is kept. A prefix sum over the chunks' counts then gives every kept record its new index, and copy(from, to) moves it there.
+     * allocate_output(kept) is called in between, once the total is known.
+     *
+     * @param chunk_size Smallest chunk to split the work into. SIZE_MAX runs everything on the calling thread.
+     * @return The number of records kept.
+     */
+    template<typename Mask, typename Allocate, typename Copy>
+    inline size_t compact_records(size_t count, Mask&& mask, Allocate&& allocate_output, Copy&& copy, size_t chunk_size = FILTER_CHUNK) {
+        std::vector<std::uint8_t> flags(count);
+        std::vector<size_t> offsets(chunk_count(count, chunk_size) + 1, 0);
+        parallel_chunks(count, chunk_size, [&](size_t chunk, size_t begin, size_t end) {
+            mask(begin, end, flags.data());
+            size_t kept = 0;
+            for (size_t i = begin; i < end; i++) {
+                kept += flags[i];
+            }
+            offsets[chunk + 1] = kept;
+        });
+        for (size_t chunk = 1; chunk < offsets.size(); chunk++) {
+            offsets[chunk] += offsets[chunk - 1];
         }
-        int* out_edges_ptr = output->edgelist.get();
-        REAL* out_norms_ptr = output->normlist.get();
-        int* out_markers_ptr = output->edgemarkerlist.get();
-        size_t num_found_edges = input->numberofedges;
-        for (size_t i = 0; i < edges; i++) {
-            if (predicate(edges_ptr[i * 2], edges_ptr[i * 2 + 1], norms_ptr[i * 2], norms_ptr[i * 2 + 1])) {
-                num_found_edges++;
-                memcpy(out_edges_ptr, edges_ptr + i * 2, sizeof(int) * 2);
-                out_edges_ptr += 2;
-                memcpy(out_norms_ptr, norms_ptr + i * 2, sizeof(REAL) * 2);
-                out_norms_ptr += 2;
-                if (markers) {
-                    memcpy(out_markers_ptr, markers_ptr + i * 2, sizeof(int) * 2);
-                    out_markers_ptr++;
+        allocate_output(offsets.back());
+        parallel_chunks(count, chunk_size, [&](size_t chunk, size_t begin, size_t end) {
+            size_t to = offsets[chunk];
+            for (size_t i = begin; i < end; i++) {
+                if (flags[i]) {
+                    copy(i, to++);
                 }
             }
-        }
-        output->numberofedges = num_found_edges;
+        });
+        return offsets.back();
+    }
+
+    /**
+     * @brief Copy the points mask keeps, with their attributes and markers, into output. See compact_records.
+     */
+    template<typename Mask>
+    inline void filter_points_by_mask(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, Mask&& mask, size_t chunk_size = FILTER_CHUNK) {
+        const size_t attributes = input->numberofpointattributes;
+        const bool markers = input->pointmarkerlist != nullptr;
+        const REAL* point_ptr = input->pointlist.get();
+        const REAL* attribute_ptr = input->pointattributelist.get();
+        const int* marker_ptr = input->pointmarkerlist.get();
+        REAL* out_point_ptr = nullptr;
+        REAL* out_attribute_ptr = nullptr;
+        int* out_marker_ptr = nullptr;
+        output->numberofpoints = compact_records(input->numberofpoints, mask, [&](size_t kept) {
+            output->numberofpointattributes = attributes;
+            output->pointlist = allocate<REAL>(kept * 2);
+            out_point_ptr = output->pointlist.get();
+            output->pointattributelist = attributes > 0 ? allocate<REAL>(kept * attributes) : nullptr;
+            out_attribute_ptr = output->pointattributelist.get();
+            output->pointmarkerlist = markers ? allocate<int>(kept) : nullptr;
+            out_marker_ptr = output->pointmarkerlist.get();
+        }, [&](size_t from, size_t to) {
+            out_point_ptr[to * 2] = point_ptr[from * 2];
+            out_point_ptr[to * 2 + 1] = point_ptr[from * 2 + 1];
+            for (size_t j = 0; j < attributes; j++) {
+                out_attribute_ptr[to * attributes + j] = attribute_ptr[from * attributes + j];
+            }
+            if (markers) {
+                out_marker_ptr[to] = marker_ptr[from];
+            }
+        }, chunk_size);
+    }
+
+    /**
+     * @brief Copy the edges mask keeps, with their norms and markers, into output. See compact_records.
+     */
+    template<typename Mask>
+    inline void filter_edges_by_mask(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, Mask&& mask, size_t chunk_size = FILTER_CHUNK) {
+        const bool norms = input->normlist != nullptr;
+        const bool markers = input->edgemarkerlist != nullptr;
+        const int* edge_ptr = input->edgelist.get();
+        const REAL* norm_ptr = input->normlist.get();
+        const int* marker_ptr = input->edgemarkerlist.get();
+        int* out_edge_ptr = nullptr;
+        REAL* out_norm_ptr = nullptr;
+        int* out_marker_ptr = nullptr;
+        output->numberofedges = compact_records(input->numberofedges, mask, [&](size_t kept) {
+            output->edgelist = allocate<int>(kept * 2);
+            out_edge_ptr = output->edgelist.get();
+            output->normlist = norms ? allocate<REAL>(kept * 2) : nullptr;
+            out_norm_ptr = output->normlist.get();
+            output->edgemarkerlist = markers ? allocate<int>(kept) : nullptr;
+            out_marker_ptr = output->edgemarkerlist.get();
+        }, [&](size_t from, size_t to) {
+            out_edge_ptr[to * 2] = edge_ptr[from * 2];
+            out_edge_ptr[to * 2 + 1] = edge_ptr[from * 2 + 1];
+            if (norms) {
+                out_norm_ptr[to * 2] = norm_ptr[from * 2];
+                out_norm_ptr[to * 2 + 1] = norm_ptr[from * 2 + 1];
+            }
+            if (markers) {
+                out_marker_ptr[to] = marker_ptr[from];
+            }
+        }, chunk_size);
+    }
+
+    /**
+     * @brief The mask filter_points uses: predicate(index, x, y, attribute) for any of a point's attributes, or for 0 if it has none.
+     */
+    template<typename Predicate>
+    inline auto point_predicate_mask(const triangulateio& input, Predicate& predicate) {
+        return [&predicate, attributes = size_t(input.numberofpointattributes), point_ptr = input.pointlist.get(), attribute_ptr = input.pointattributelist.get()](size_t begin, size_t end, std::uint8_t* flags) {
+            for (size_t i = begin; i < end; i++) {
+                const REAL x = point_ptr[i * 2], y = point_ptr[i * 2 + 1];
+                bool keep = attributes == 0 && predicate(int(i), x, y, REAL(0));
+                for (size_t j = 0; j < attributes && !keep; j++) {
+                    keep = predicate(int(i), x, y, attribute_ptr[i * attributes + j]);
+                }
+                flags[i] = keep;
+            }
+        };
+    }
+
+    /**
+     * @brief The mask filter_edges uses: predicate(first, second, norm_x, norm_y), with norms 0 if the input has none.
+     */
+    template<typename Predicate>
+    inline auto edge_predicate_mask(const triangulateio& input, Predicate& predicate) {
+        return [&predicate, edge_ptr = input.edgelist.get(), norm_ptr = input.normlist.get()](size_t begin, size_t end, std::uint8_t* flags) {
+            for (size_t i = begin; i < end; i++) {
+                const REAL norm_x = norm_ptr ? norm_ptr[i * 2] : 0, norm_y = norm_ptr ? norm_ptr[i * 2 + 1] : 0;
+                flags[i] = predicate(edge_ptr[i * 2], edge_ptr[i * 2 + 1], norm_x, norm_y);
+            }
+        };
+    }
+
+    /**
+     * @brief Keep the points where predicate(index, x, y, attribute) holds for any of their attributes, or for 0 if they have none.
+     * The predicate is inlined, and called from several threads at once on large inputs, so it must be safe to call concurrently.
+     */
+    template<typename Predicate> requires std::is_invocable_r_v<bool, Predicate&, int, REAL, REAL, REAL>
+    inline void filter_points(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, Predicate&& predicate) {
+        filter_points_by_mask(input, output, point_predicate_mask(*input, predicate));
     }
+
+    /**
+     * @brief Keep the edges where predicate(first, second, norm_x, norm_y) holds. Norms are 0 if the input has none.
+     * Like filter_points, the predicate must be safe to call concurrently.
+     */
+    template<typename Predicate> requires std::is_invocable_r_v<bool, Predicate&, const int&, const int&, const double&, const double&>
+    inline void filter_edges(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, Predicate&& predicate) {
+        filter_edges_by_mask(input, output, edge_predicate_mask(*input, predicate));
+    }
+
+    /**
+     * @brief The std::function filters call their predicate in order on the calling thread, as they always have, so it may keep state or throw.
+     */
+    void filter_edges(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, std::function<bool(const int&, const int& , const double&, const double&)> predicate);
     void filter_points(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, std::function<bool(int, REAL, REAL, REAL)> predicate);
+    /**
+     * @brief Keep the points inside a box, borders included. The test is branch free, so it vectorizes.
+     */
+    void filter_points_in_box(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, REAL min_x, REAL min_y, REAL max_x, REAL max_y);
+    /**
+     * @brief Keep the points with a given marker. Keeps nothing if the input has no markers.
+     */
+    void filter_points_with_marker(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, int marker);
+    /**
+     * @brief Keep the edges with a given marker. Keeps nothing if the input has no markers.
+     */
+    void filter_edges_with_marker(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, int marker);
+    /**
+     * @brief Drop unused points and the elements that lost a corner, renumbering what is left so it can be used without triangulating again.
+     * Triangles, segments and edges survive if all their points are kept, and points survive if a surviving element uses them.
+     * A mesh with no elements just keeps the flagged points. Neighbors across removed triangles become -1, and holes and regions are shared.
+     * Indices are taken as zero based. Triangles keep numberofcorners corners, so second order meshes from the o2 switch keep their
+     * midpoint nodes. output may be input, to shrink a mesh in place.
+     *
+     * @param keep_points One flag per point, or empty to keep them all and only drop the unused ones.
+     */
+    void compact(std::shared_ptr<const triangulateio> input, std::shared_ptr<triangulateio> output, std::span<const std::uint8_t> keep_points = {});
+    /**
+     * @brief compact, keeping the points where predicate(index, x, y) holds. Like filter_points, the predicate must be safe to call concurrently.
+     */
+    template<typename Predicate> requires std::is_invocable_r_v<bool, Predicate&, int, REAL, REAL>
+    inline void compact(std::shared_ptr<const triangulateio> input, std::shared_ptr<triangulateio> output, Predicate&& predicate) {
+        std::vector<std::uint8_t> keep_points(input->numberofpoints);
+        const REAL* point_ptr = input->pointlist.get();
+        parallel_chunks(keep_points.size(), FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                keep_points[i] = predicate(int(i), point_ptr[i * 2], point_ptr[i * 2 + 1]);
+            }
+        });
+        compact(input, output, keep_points);
+    }
     void inject_holes(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output);
     template <typename T>
     inline T parse_str(const std::string& str);
@@ -250,20 +321,31 @@ namespace TriangleManipulator {
     void write_part_file(std::string filename, std::shared_ptr<const triangulateio> out);
 
     // Binary output. Designed to be robust, and compact.
+    // The filename versions use a buffered reader/writer. Pass a reader or writer to pick a backend, e.g. read_mode::mapped to avoid copying arrays.
     void read_node_file_binary(std::string filename, std::shared_ptr<triangulateio> in);
+    void read_node_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in);
     void write_node_file_binary(std::string filename, std::shared_ptr<const triangulateio> out);
+    void write_node_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out);
 
-    void read_poly_file_binary(std::string filename, std::shared_ptr<const triangulateio> in);
+    void read_poly_file_binary(std::string filename, std::shared_ptr<triangulateio> in);
+    void read_poly_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in);
     void write_poly_file_binary(std::string filename, std::shared_ptr<const triangulateio> out);
+    void write_poly_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out);
     
     void read_ele_file_binary(std::string filename, std::shared_ptr<triangulateio> in);
+    void read_ele_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in);
     void write_ele_file_binary(std::string filename, std::shared_ptr<const triangulateio> out);
+    void write_ele_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out);
 
     void read_edge_file_binary(std::string filename, std::shared_ptr<triangulateio> in);
+    void read_edge_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in);
     void write_edge_file_binary(std::string filename, std::shared_ptr<const triangulateio> out);
+    void write_edge_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out);
 
     void read_neigh_file_binary(std::string filename, std::shared_ptr<triangulateio> in);
+    void read_neigh_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in);
     void write_neigh_file_binary(std::string filename, std::shared_ptr<const triangulateio> out);
+    void write_neigh_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out);
 }
 
 #endif /* TRIANGLEMANIPULATOR_HPP_ */
\ No newline at end of file
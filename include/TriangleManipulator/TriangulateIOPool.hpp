@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef TRIANGULATEIOPOOL_HPP_
+#define TRIANGULATEIOPOOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <triangle.h>
+
+namespace TriangleManipulator {
+    /**
+     * @brief Recycles triangulateio shells and their arrays, so loops that keep loading and filtering meshes stop going to the allocator.
+     * Arrays come out as ordinary shared_ptr<T[]>, and go back to the pool when their last owner lets go. Blocks are kept in power of two
+     * size classes, so an array can be reused by any later request that fits. Arrays outliving their pool are freed normally.
+     * Safe to share between threads.
+     */
+    class TriangulateIOPool {
+        private:
+            struct State;
+            std::shared_ptr<State> state;
+            void* acquire(size_t bytes, unsigned int& size_class);
+            static void release(const std::weak_ptr<State>& state, void* block, unsigned int size_class);
+        public:
+            struct Stats {
+                /**
+                 * @brief Requests served from a recycled block or shell.
+                 */
+                size_t hits;
+                size_t misses;
+                /**
+                 * @brief Bytes held in free blocks right now.
+                 */
+                size_t retained_bytes;
+            };
+            /**
+             * @brief An empty pool. Blocks are only kept once they have been given back.
+             *
+             * @param max_retained_bytes Free blocks past this many bytes go back to the allocator instead of being kept.
+             */
+            TriangulateIOPool(size_t max_retained_bytes = size_t(256) << 20);
+            TriangulateIOPool(const TriangulateIOPool&) = delete;
+            TriangulateIOPool& operator=(const TriangulateIOPool&) = delete;
+            /**
+             * @brief An uninitialized array of count elements, like trimalloc.
+             */
+            template<typename T>
+            inline std::shared_ptr<T[]> allocate(size_t count) {
+                static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Only plain arrays can be recycled");
+                unsigned int size_class;
+                T* data = static_cast<T*>(acquire(sizeof(T) * count, size_class));
+                return std::shared_ptr<T[]>(data, [state = std::weak_ptr<State>(state), size_class](T* block) {
+                    release(state, block, size_class);
+                });
+            }
+            /**
+             * @brief An empty triangulateio, like TriangleManipulator::create_instance. Its arrays are dropped when it comes back.
+             */
+            std::shared_ptr<triangulateio> create_instance();
+            /**
+             * @brief Free every block and shell held right now.
+             */
+            void trim();
+            Stats stats() const;
+            /**
+             * @brief Routes allocate() and create_instance() on this thread through a pool while alive. Scopes nest, and mustn't outlive their pool.
+             */
+            class Scope {
+                private:
+                    TriangulateIOPool* previous;
+                public:
+                    Scope(TriangulateIOPool& pool);
+                    ~Scope();
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+            };
+            /**
+             * @brief The pool of this thread's innermost Scope, or nullptr.
+             */
+            static TriangulateIOPool* current();
+    };
+
+    /**
+     * @brief trimalloc, drawing from the current thread's pool if there is one.
+     */
+    template<typename T>
+    inline std::shared_ptr<T[]> allocate(size_t count) {
+        if (TriangulateIOPool* pool = TriangulateIOPool::current()) {
+            return pool->allocate<T>(count);
+        }
+        return trimalloc<T>(count);
+    }
+}
+
+#endif /* TRIANGULATEIOPOOL_HPP_ */
@@ -0,0 +1,262 @@
+#include "TriangleManipulator/BinaryIO.hpp"
+#include "fmt/format.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TriangleManipulator {
+    /**
+     * @brief Block size used for aligned writes. Covers the logical block size of every filesystem we care about.
+     */
+    constexpr size_t DIRECT_ALIGNMENT = 4096;
+    constexpr size_t DEFAULT_DIRECT_BUFFER = 1 << 20;
+
+    [[noreturn]] inline void throw_io_error(const std::string& what, const std::string& filename) {
+        throw std::runtime_error(fmt::format("{} '{}': {}", what, filename, std::strerror(errno)));
+    }
+
+    file_mapping::~file_mapping() {
+        if (address != nullptr) {
+            munmap(address, size);
+        }
+    }
+
+    binary_writer::binary_writer() : filename("<memory>"), file(nullptr), stdio_buffer(), descriptor(-1), block_buffer(nullptr, &std::free), block_capacity(0), block_fill(0), written(0), in_memory(true), padded_arrays(false), memory() {
+    }
+
+    binary_writer::binary_writer(const char* filename, write_mode mode, size_t buffer_size) : filename(filename), file(nullptr), stdio_buffer(), descriptor(-1), block_buffer(nullptr, &std::free), block_capacity(0), block_fill(0), written(0), in_memory(false), padded_arrays(false), memory() {
+        if (mode == write_mode::buffered) {
+            file = std::fopen(filename, "wb");
+            if (file == nullptr) {
+                throw_io_error("Could not open", this->filename);
+            }
+            if (buffer_size > 0) {
+                stdio_buffer = std::make_unique_for_overwrite<char[]>(buffer_size);
+                std::setvbuf(file, stdio_buffer.get(), _IOFBF, buffer_size);
+            }
+            return;
+        }
+        descriptor = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (descriptor < 0 && errno == EINVAL) {
+            // The filesystem doesn't do O_DIRECT (tmpfs, for example). Keep the aligned block writes anyway.
+            descriptor = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (descriptor < 0) {
+            throw_io_error("Could not open", this->filename);
+        }
+        block_capacity = std::max(DIRECT_ALIGNMENT, (buffer_size == 0 ? DEFAULT_DIRECT_BUFFER : buffer_size + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT);
+        block_buffer.reset(static_cast<char*>(std::aligned_alloc(DIRECT_ALIGNMENT, block_capacity)));
+        if (!block_buffer) {
+            throw std::bad_alloc();
+        }
+    }
+
+    binary_writer::~binary_writer() {
+        if (file != nullptr || descriptor >= 0) {
+            try {
+                close();
+            } catch (const std::runtime_error&) {
+                // Nothing sensible to do from a destructor. Call close() to see the error.
+            }
+        }
+    }
+
+    void binary_writer::write_bytes(const void* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        written += size;
+        if (in_memory) {
+            const char* bytes = static_cast<const char*>(data);
+            memory.insert(memory.end(), bytes, bytes + size);
+            return;
+        }
+        if (file != nullptr) {
+            if (std::fwrite(data, 1, size, file) != size) {
+                throw_io_error("Short write to", filename);
+            }
+            return;
+        }
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            const size_t amount = std::min(size, block_capacity - block_fill);
+            std::memcpy(block_buffer.get() + block_fill, bytes, amount);
+            block_fill += amount;
+            bytes += amount;
+            size -= amount;
+            if (block_fill == block_capacity) {
+                flush_blocks(false);
+            }
+        }
+    }
+
+    void binary_writer::pad_to(size_t alignment) {
+        static constexpr char zeros[64] = {};
+        const size_t padding = (alignment - written % alignment) % alignment;
+        write_bytes(zeros, padding);
+    }
+
+    void binary_writer::flush_blocks(bool final) {
+        size_t length = block_fill;
+        if (final) {
+            // The tail gets padded out to a whole block, and trimmed off again with ftruncate.
+            length = (block_fill + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+            std::memset(block_buffer.get() + block_fill, 0, length - block_fill);
+        }
+        const char* data = block_buffer.get();
+        while (length > 0) {
+            const ssize_t result = ::write(descriptor, data, length);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw_io_error("Short write to", filename);
+            }
+            data += result;
+            length -= result;
+        }
+        block_fill = 0;
+    }
+
+    void binary_writer::close() {
+        if (file != nullptr) {
+            const int result = std::fclose(file);
+            file = nullptr;
+            if (result != 0) {
+                throw_io_error("Could not close", filename);
+            }
+        } else if (descriptor >= 0) {
+            try {
+                flush_blocks(true);
+            } catch (...) {
+                ::close(descriptor);
+                descriptor = -1;
+                throw;
+            }
+            const bool truncated = ::ftruncate(descriptor, written) == 0;
+            const bool closed = ::close(descriptor) == 0;
+            descriptor = -1;
+            if (!truncated || !closed) {
+                throw_io_error("Could not close", filename);
+            }
+        }
+    }
+
+    binary_reader::binary_reader(const char* filename, read_mode mode, size_t buffer_size) : filename(filename), file(nullptr), stdio_buffer(), mapping(), start(nullptr), cursor(nullptr), end(nullptr), padded_arrays(false) {
+        if (mode == read_mode::buffered) {
+            file = std::fopen(filename, "rb");
+            if (file == nullptr) {
+                throw_io_error("Could not open", this->filename);
+            }
+            if (buffer_size > 0) {
+                stdio_buffer = std::make_unique_for_overwrite<char[]>(buffer_size);
+                std::setvbuf(file, stdio_buffer.get(), _IOFBF, buffer_size);
+            }
+            return;
+        }
+        const int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) {
+            throw_io_error("Could not open", this->filename);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw_io_error("Could not stat", this->filename);
+        }
+        const size_t size = info.st_size;
+        char* address = nullptr;
+        if (size > 0) {
+            // Private and writable, so arrays handed out by read_array can be modified like any other triangulateio array.
+            void* result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (result == MAP_FAILED) {
+                ::close(fd);
+                throw_io_error("Could not map", this->filename);
+            }
+            address = static_cast<char*>(result);
+        }
+        ::close(fd);
+        mapping = std::make_shared<const file_mapping>(address, size);
+        start = cursor = address;
+        end = address + size;
+    }
+
+    binary_reader::binary_reader(std::string filename, std::shared_ptr<const file_mapping> mapping, size_t offset, size_t length) : filename(std::move(filename)), file(nullptr), stdio_buffer(), mapping(std::move(mapping)), start(nullptr), cursor(nullptr), end(nullptr), padded_arrays(false) {
+        if (offset > this->mapping->size || length > this->mapping->size - offset) {
+            throw std::runtime_error(fmt::format("Section [{}, {}) is outside of '{}'", offset, offset + length, this->filename));
+        }
+        start = cursor = this->mapping->address + offset;
+        end = cursor + length;
+    }
+
+    binary_reader::binary_reader(binary_reader&& other) noexcept : filename(std::move(other.filename)), file(other.file), stdio_buffer(std::move(other.stdio_buffer)), mapping(std::move(other.mapping)), start(other.start), cursor(other.cursor), end(other.end), padded_arrays(other.padded_arrays) {
+        other.file = nullptr;
+        other.start = other.cursor = other.end = nullptr;
+    }
+
+    binary_reader::~binary_reader() {
+        close();
+    }
+
+    void binary_reader::read_bytes(void* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        if (file != nullptr) {
+            if (std::fread(data, 1, size, file) != size) {
+                throw std::runtime_error(fmt::format("Unexpected end of '{}'", filename));
+            }
+            return;
+        }
+        std::memcpy(data, take_bytes(size), size);
+    }
+
+    const char* binary_reader::take_bytes(size_t size) {
+        if (!mapping) {
+            throw std::logic_error("binary_reader: in place access requires read_mode::mapped");
+        }
+        if (size > static_cast<size_t>(end - cursor)) {
+            throw std::runtime_error(fmt::format("Unexpected end of '{}'", filename));
+        }
+        const char* result = cursor;
+        cursor += size;
+        return result;
+    }
+
+    void binary_reader::skip(size_t size) {
+        if (file != nullptr) {
+            if (std::fseek(file, size, SEEK_CUR) != 0) {
+                throw_io_error("Could not seek in", filename);
+            }
+            return;
+        }
+        take_bytes(size);
+    }
+
+    size_t binary_reader::tell() const {
+        if (file != nullptr) {
+            return std::ftell(file);
+        }
+        return cursor - start;
+    }
+
+    binary_reader binary_reader::sub_reader(size_t offset, size_t length) const {
+        if (!mapping) {
+            throw std::logic_error("binary_reader: sub readers require read_mode::mapped");
+        }
+        return binary_reader(filename, mapping, (start - mapping->address) + offset, length);
+    }
+
+    void binary_reader::close() {
+        if (file != nullptr) {
+            std::fclose(file);
+            file = nullptr;
+        }
+        // Arrays handed out by read_array keep the mapping alive on their own.
+        mapping.reset();
+        start = cursor = end = nullptr;
+    }
+}
@@ -0,0 +1,85 @@
+#include "TriangleManipulator/LocatorCache.hpp"
+#include "TriangleManipulator/TriangleManipulator.hpp"
+#include "TriangleManipulator/Hash.hpp"
+#include "TriangleManipulator/MeshBundle.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace PointLocation {
+    LocatorCache::LocatorCache(std::filesystem::path directory) : directory(std::move(directory)) {
+        std::filesystem::create_directories(this->directory);
+    }
+
+    std::uint64_t LocatorCache::key(std::shared_ptr<const triangulateio> input, std::shared_ptr<const triangulateio> mapped, const LocatorBuildOptions& options) {
+        using TriangleManipulator::hash_array;
+        const std::uint64_t counts[] = {
+            LocatorBuildOptions::version,
+            static_cast<std::uint64_t>(input->numberofpoints),
+            static_cast<std::uint64_t>(input->numberofsegments),
+            static_cast<std::uint64_t>(input->numberoftriangles),
+            static_cast<std::uint64_t>(mapped->numberoftriangles)
+        };
+        std::uint64_t hash = hash_array(counts, std::size(counts));
+        hash = hash_array(input->pointlist.get(), input->numberofpoints * 2, hash);
+        hash = hash_array(input->segmentlist.get(), input->numberofsegments * 2, hash);
+        hash = hash_array(input->trianglelist.get(), input->numberoftriangles * 3, hash);
+        hash = hash_array(mapped->trianglelist.get(), mapped->numberoftriangles * 3, hash);
+        return hash_array(options.tag.data(), options.tag.size(), hash);
+    }
+
+    std::filesystem::path LocatorCache::path_for(std::uint64_t key) const {
+        return directory / fmt::format("{:016x}.locator", key);
+    }
+
+    std::shared_ptr<GraphInfo> LocatorCache::get(std::uint64_t key, load_mode mode) const {
+        const std::filesystem::path path = path_for(key);
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error)) {
+            return nullptr;
+        }
+        std::shared_ptr<GraphInfo> info = std::make_shared<GraphInfo>();
+        try {
+            const TriangleManipulator::mesh_bundle bundle(path.string().c_str());
+            info->read_from_bundle(bundle, true, mode);
+        } catch (const std::exception&) {
+            // Truncated or damaged: drop it so the rebuild replaces it. A bad length can surface as length_error or bad_alloc, not just runtime_error.
+            std::filesystem::remove(path, error);
+            return nullptr;
+        }
+        return info;
+    }
+
+    void LocatorCache::put(std::uint64_t key, const GraphInfo& info) const {
+        static std::atomic<unsigned int> counter = 0;
+        const std::filesystem::path path = path_for(key);
+        std::filesystem::path temporary = path;
+        temporary += fmt::format(".{}.{}.tmp", ::getpid(), counter++);
+        try {
+            TriangleManipulator::bundle_writer bundle(temporary.string().c_str());
+            info.write_to_bundle(bundle);
+            bundle.close();
+            std::filesystem::rename(temporary, path);
+        } catch (...) {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            throw;
+        }
+    }
+
+    std::shared_ptr<GraphInfo> LocatorCache::get_or_build(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> mapped, const LocatorBuildOptions& options, bool* hit) const {
+        const std::uint64_t cache_key = key(input, mapped, options);
+        std::shared_ptr<GraphInfo> info = get(cache_key, options.mode);
+        if (hit != nullptr) {
+            *hit = (bool) info;
+        }
+        if (info) {
+            return info;
+        }
+        info = std::make_shared<GraphInfo>(input);
+        info->process();
+        info->map_triangles(mapped);
+        put(cache_key, *info);
+        return info;
+    }
+}
@@ -0,0 +1,148 @@
+#include "TriangleManipulator/MeshBundle.hpp"
+#include "TriangleManipulator/Hash.hpp"
+#include <stdexcept>
+
+namespace TriangleManipulator {
+    inline void pad_to_alignment(binary_writer& writer) {
+        static constexpr char zeros[BUNDLE_SECTION_ALIGNMENT] = {};
+        writer.write_array(zeros, (BUNDLE_SECTION_ALIGNMENT - writer.tell() % BUNDLE_SECTION_ALIGNMENT) % BUNDLE_SECTION_ALIGNMENT);
+    }
+
+    bundle_writer::bundle_writer(const char* filename, write_mode mode, size_t buffer_size) : writer(filename, mode, buffer_size), sections(), closed(false) {
+        writer.write(BUNDLE_MAGIC);
+        writer.write(BUNDLE_VERSION);
+        pad_to_alignment(writer);
+    }
+
+    bundle_writer::~bundle_writer() {
+        if (!closed) {
+            try {
+                close();
+            } catch (const std::runtime_error&) {
+                // Call close() to see the error.
+            }
+        }
+    }
+
+    void bundle_writer::add_section(section_type type, std::span<const char> contents) {
+        bundle_section& section = sections.emplace_back();
+        section.type = type;
+        section.reserved = 0;
+        section.offset = writer.tell();
+        section.length = contents.size();
+        section.checksum = hash_bytes(contents);
+        writer.write_array(contents.data(), contents.size());
+        pad_to_alignment(writer);
+    }
+
+    void bundle_writer::add_node(std::shared_ptr<const triangulateio> out) {
+        add_section(section_type::node, [&](binary_writer& section) {
+            write_node_file_binary(section, out);
+        });
+    }
+
+    void bundle_writer::add_poly(std::shared_ptr<const triangulateio> out) {
+        add_section(section_type::poly, [&](binary_writer& section) {
+            write_poly_file_binary(section, out);
+        });
+    }
+
+    void bundle_writer::add_ele(std::shared_ptr<const triangulateio> out) {
+        add_section(section_type::ele, [&](binary_writer& section) {
+            write_ele_file_binary(section, out);
+        });
+    }
+
+    void bundle_writer::add_edge(std::shared_ptr<const triangulateio> out) {
+        add_section(section_type::edge, [&](binary_writer& section) {
+            write_edge_file_binary(section, out);
+        });
+    }
+
+    void bundle_writer::add_neigh(std::shared_ptr<const triangulateio> out) {
+        add_section(section_type::neigh, [&](binary_writer& section) {
+            write_neigh_file_binary(section, out);
+        });
+    }
+
+    void bundle_writer::close() {
+        closed = true;
+        bundle_trailer trailer;
+        trailer.magic = BUNDLE_MAGIC;
+        trailer.version = BUNDLE_VERSION;
+        trailer.section_count = sections.size();
+        trailer.table_offset = writer.tell();
+        trailer.table_checksum = hash_array(sections.data(), sections.size());
+        writer.write_array(sections.data(), sections.size());
+        writer.write(trailer);
+        writer.close();
+    }
+
+    mesh_bundle::mesh_bundle(const char* filename) : reader(filename, read_mode::mapped), table() {
+        const std::span<const char> bytes = reader.mapped_bytes();
+        if (bytes.size() < BUNDLE_SECTION_ALIGNMENT + sizeof(bundle_trailer)) {
+            throw std::runtime_error(fmt::format("'{}' is too small to be a mesh bundle", filename));
+        }
+        binary_reader trailer_reader = reader.sub_reader(bytes.size() - sizeof(bundle_trailer), sizeof(bundle_trailer));
+        const bundle_trailer trailer = trailer_reader.read<bundle_trailer>();
+        if (trailer.magic != BUNDLE_MAGIC || reader.read<std::uint64_t>() != BUNDLE_MAGIC) {
+            throw std::runtime_error(fmt::format("'{}' is not a mesh bundle", filename));
+        }
+        if (trailer.version != BUNDLE_VERSION) {
+            throw std::runtime_error(fmt::format("'{}' is mesh bundle version {}, expected {}", filename, trailer.version, BUNDLE_VERSION));
+        }
+        binary_reader table_reader = reader.sub_reader(trailer.table_offset, sizeof(bundle_section) * trailer.section_count);
+        table.resize(trailer.section_count);
+        table_reader.read_array(table.data(), table.size());
+        if (hash_array(table.data(), table.size()) != trailer.table_checksum) {
+            throw std::runtime_error(fmt::format("'{}' has a corrupt section table", filename));
+        }
+    }
+
+    std::optional<bundle_section> mesh_bundle::find(section_type type) const {
+        for (const bundle_section& section : table) {
+            if (section.type == type) {
+                return section;
+            }
+        }
+        return std::nullopt;
+    }
+
+    binary_reader mesh_bundle::section(section_type type, bool verify) const {
+        const std::optional<bundle_section> section = find(type);
+        if (!section) {
+            throw std::runtime_error(fmt::format("Mesh bundle has no section of type {}", static_cast<std::uint32_t>(type)));
+        }
+        binary_reader result = reader.sub_reader(section->offset, section->length);
+        if (verify && hash_bytes(result.mapped_bytes()) != section->checksum) {
+            throw std::runtime_error(fmt::format("Mesh bundle section of type {} fails its checksum", static_cast<std::uint32_t>(type)));
+        }
+        result.pad_arrays(true);
+        return result;
+    }
+
+    void mesh_bundle::read_node(std::shared_ptr<triangulateio> in, bool verify) const {
+        binary_reader section_reader = section(section_type::node, verify);
+        read_node_file_binary(section_reader, in);
+    }
+
+    void mesh_bundle::read_poly(std::shared_ptr<triangulateio> in, bool verify) const {
+        binary_reader section_reader = section(section_type::poly, verify);
+        read_poly_file_binary(section_reader, in);
+    }
+
+    void mesh_bundle::read_ele(std::shared_ptr<triangulateio> in, bool verify) const {
+        binary_reader section_reader = section(section_type::ele, verify);
+        read_ele_file_binary(section_reader, in);
+    }
+
+    void mesh_bundle::read_edge(std::shared_ptr<triangulateio> in, bool verify) const {
+        binary_reader section_reader = section(section_type::edge, verify);
+        read_edge_file_binary(section_reader, in);
+    }
+
+    void mesh_bundle::read_neigh(std::shared_ptr<triangulateio> in, bool verify) const {
+        binary_reader section_reader = section(section_type::neigh, verify);
+        read_neigh_file_binary(section_reader, in);
+    }
+}
@@ -0,0 +1,511 @@
+#include "TriangleManipulator/NavHierarchy.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+namespace PointLocation {
+    namespace {
+        constexpr unsigned int NONE = static_cast<unsigned int>(-1);
+
+        inline double distance(const Vertex::Point& a, const Vertex::Point& b) {
+            return std::hypot(a.x - b.x, a.y - b.y);
+        }
+
+        struct OpenEntry {
+            double estimate;
+            double cost;
+            unsigned int node;
+            constexpr bool operator>(const OpenEntry& rhs) const {
+                return estimate > rhs.estimate;
+            }
+        };
+
+        /**
+         * @brief Best first search state, stamped like NavMesh's so nothing needs clearing between searches.
+         */
+        struct SearchState {
+            std::vector<std::uint32_t> stamp;
+            std::vector<double> cost;
+            std::vector<unsigned int> parent;
+            // Triangle searches: where each triangle was entered. The portal search: which cluster the step to each portal went through.
+            std::vector<Vertex::Point> position;
+            std::vector<unsigned int> via;
+            std::vector<OpenEntry> open;
+            std::uint32_t generation = 0;
+            inline void prepare(size_t nodes) {
+                if (stamp.size() < nodes) {
+                    stamp.resize(nodes, 0);
+                    cost.resize(nodes);
+                    parent.resize(nodes);
+                    position.resize(nodes);
+                    via.resize(nodes);
+                }
+                if (++generation == 0) {
+                    std::fill(stamp.begin(), stamp.end(), 0);
+                    generation = 1;
+                }
+                open.clear();
+            }
+            inline bool reached(unsigned int node) const {
+                return stamp[node] == generation;
+            }
+            inline bool improve(unsigned int node, double new_cost, unsigned int from) {
+                if (reached(node) && cost[node] <= new_cost) {
+                    return false;
+                }
+                stamp[node] = generation;
+                cost[node] = new_cost;
+                parent[node] = from;
+                return true;
+            }
+            inline void push(double estimate, double new_cost, unsigned int node) {
+                open.push_back({ estimate, new_cost, node });
+                std::push_heap(open.begin(), open.end(), std::greater<>());
+            }
+            inline OpenEntry pop() {
+                std::pop_heap(open.begin(), open.end(), std::greater<>());
+                const OpenEntry entry = open.back();
+                open.pop_back();
+                return entry;
+            }
+        };
+
+        // Separate states, as a query runs triangle searches and the portal search side by side.
+        thread_local SearchState triangle_search;
+        thread_local SearchState portal_search;
+        thread_local std::vector<unsigned int> route_portals;
+        thread_local std::vector<unsigned int> leg_corridor;
+
+        /**
+         * @brief Best first search over the walkable triangles allowed accepts, from start entered at start_point, with steps between side midpoints
+         * like NavMesh::find_corridor. Stepping into goal lands on goal_point. heuristic must not overestimate; with a zero one this is Dijkstra.
+         * settle(triangle) is called once for each triangle as its cost becomes final, and stops the search by returning true.
+         */
+        template<typename Allowed, typename Heuristic, typename Settle>
+        void search_triangles(const NavMesh& mesh, SearchState& state, unsigned int start, Vertex::Point start_point, unsigned int goal, Vertex::Point goal_point, Allowed&& allowed, Heuristic&& heuristic, Settle&& settle) {
+            state.prepare(mesh.triangle_count());
+            state.improve(start, 0, start);
+            state.position[start] = start_point;
+            state.push(heuristic(start_point), 0, start);
+            while (!state.open.empty()) {
+                const OpenEntry current = state.pop();
+                if (current.cost > state.cost[current.node]) {
+                    continue;
+                }
+                if (settle(current.node)) {
+                    return;
+                }
+                const Vertex::Point from = state.position[current.node];
+                const unsigned int* corner = mesh.triangle_corners(current.node);
+                for (unsigned int side = 0; side < 3; side++) {
+                    const int next = mesh.neighbor(current.node, side);
+                    if (next < 0 || !allowed((unsigned int) next)) {
+                        continue;
+                    }
+                    const Vertex::Point& a = mesh.point(corner[(side + 1) % 3]);
+                    const Vertex::Point& b = mesh.point(corner[(side + 2) % 3]);
+                    const Vertex::Point to = (unsigned int) next == goal ? goal_point : Vertex::Point{ (a.x + b.x) / 2, (a.y + b.y) / 2 };
+                    const double cost = current.cost + distance(from, to);
+                    if (state.improve(next, cost, current.node)) {
+                        state.position[next] = to;
+                        state.push(cost + heuristic(to), cost, next);
+                    }
+                }
+            }
+        }
+
+        inline void trace(const SearchState& state, unsigned int start, unsigned int goal, std::vector<unsigned int>& corridor) {
+            corridor.clear();
+            for (unsigned int triangle = goal; triangle != start; triangle = state.parent[triangle]) {
+                corridor.push_back(triangle);
+            }
+            corridor.push_back(start);
+            std::reverse(corridor.begin(), corridor.end());
+        }
+
+        struct UnionFind {
+            std::vector<unsigned int> parent;
+            UnionFind(size_t size) : parent(size) {
+                std::iota(parent.begin(), parent.end(), 0);
+            }
+            unsigned int find(unsigned int node) {
+                while (parent[node] != node) {
+                    node = parent[node] = parent[parent[node]];
+                }
+                return node;
+            }
+            void join(unsigned int first, unsigned int second) {
+                parent[find(first)] = find(second);
+            }
+        };
+    }
+
+    NavHierarchy::NavHierarchy(const NavMesh& mesh, unsigned int cluster_triangles) : mesh(mesh), cluster_triangles(std::max(cluster_triangles, 1u)), clusters(), cluster_total(0), portals(), cluster_portal_start(), cluster_portals(), edge_start(), edges(), stats() {
+        rebuild();
+    }
+
+    void NavHierarchy::rebuild() {
+        using clock = std::chrono::steady_clock;
+        const clock::time_point build_start = clock::now();
+        const size_t count = mesh.triangle_count();
+        const auto centroid = [this](unsigned int triangle) {
+            const unsigned int* corner = mesh.triangle_corners(triangle);
+            const Vertex::Point& a = mesh.point(corner[0]);
+            const Vertex::Point& b = mesh.point(corner[1]);
+            const Vertex::Point& c = mesh.point(corner[2]);
+            return Vertex::Point{ (a.x + b.x + c.x) / 3, (a.y + b.y + c.y) / 3 };
+        };
+
+        // Clusters: triangles bucketed into square cells by centroid, then split into the pieces connected within each cell.
+        double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        size_t walkable = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            if (mesh.walkable(i)) {
+                const Vertex::Point middle = centroid(i);
+                min_x = std::min(min_x, middle.x);
+                min_y = std::min(min_y, middle.y);
+                max_x = std::max(max_x, middle.x);
+                max_y = std::max(max_y, middle.y);
+                walkable++;
+            }
+        }
+        double cell_size = std::sqrt((max_x - min_x) * (max_y - min_y) * cluster_triangles / std::max<size_t>(walkable, 1));
+        if (!(cell_size > 0)) {
+            cell_size = 1;
+        }
+        const auto cell_of = [&](unsigned int triangle) {
+            const Vertex::Point middle = centroid(triangle);
+            return std::pair(std::int64_t((middle.x - min_x) / cell_size), std::int64_t((middle.y - min_y) / cell_size));
+        };
+        clusters.assign(count, NONE);
+        cluster_total = 0;
+        std::vector<unsigned int> stack;
+        for (unsigned int i = 0; i < count; i++) {
+            if (!mesh.walkable(i) || clusters[i] != NONE) {
+                continue;
+            }
+            const auto cell = cell_of(i);
+            clusters[i] = cluster_total;
+            stack.push_back(i);
+            while (!stack.empty()) {
+                const unsigned int triangle = stack.back();
+                stack.pop_back();
+                for (unsigned int side = 0; side < 3; side++) {
+                    const int next = mesh.neighbor(triangle, side);
+                    if (next >= 0 && clusters[next] == NONE && cell_of(next) == cell) {
+                        clusters[next] = cluster_total;
+                        stack.push_back(next);
+                    }
+                }
+            }
+            cluster_total++;
+        }
+        const clock::time_point clustered = clock::now();
+
+        // Portals: edges between two clusters, joined into one portal per run of edges sharing vertices.
+        struct Crossing {
+            unsigned int first_cluster;
+            unsigned int second_cluster;
+            unsigned int triangle;
+            unsigned int side;
+        };
+        std::vector<Crossing> crossings;
+        for (unsigned int i = 0; i < count; i++) {
+            for (unsigned int side = 0; clusters[i] != NONE && side < 3; side++) {
+                const int next = mesh.neighbor(i, side);
+                if (next > (int) i && clusters[next] != clusters[i]) {
+                    crossings.push_back({ std::min(clusters[i], clusters[next]), std::max(clusters[i], clusters[next]), i, side });
+                }
+            }
+        }
+        std::sort(crossings.begin(), crossings.end(), [](const Crossing& first, const Crossing& second) {
+            return std::pair(first.first_cluster, first.second_cluster) < std::pair(second.first_cluster, second.second_cluster);
+        });
+        UnionFind runs(crossings.size());
+        std::vector<std::pair<unsigned int, unsigned int>> ends;
+        for (size_t first = 0, last = 0; first < crossings.size(); first = last) {
+            for (last = first; last < crossings.size() && crossings[last].first_cluster == crossings[first].first_cluster && crossings[last].second_cluster == crossings[first].second_cluster; last++);
+            // Edges between the same two clusters that share a vertex are part of the same run.
+            ends.clear();
+            for (size_t i = first; i < last; i++) {
+                const unsigned int* corner = mesh.triangle_corners(crossings[i].triangle);
+                ends.emplace_back(corner[(crossings[i].side + 1) % 3], i);
+                ends.emplace_back(corner[(crossings[i].side + 2) % 3], i);
+            }
+            std::sort(ends.begin(), ends.end());
+            for (size_t i = 1; i < ends.size(); i++) {
+                if (ends[i].first == ends[i - 1].first) {
+                    runs.join(ends[i].second, ends[i - 1].second);
+                }
+            }
+        }
+        // Each run is represented by its edge closest to the run's middle.
+        const auto edge_middle = [this, &crossings](size_t i) {
+            const unsigned int* corner = mesh.triangle_corners(crossings[i].triangle);
+            const Vertex::Point& a = mesh.point(corner[(crossings[i].side + 1) % 3]);
+            const Vertex::Point& b = mesh.point(corner[(crossings[i].side + 2) % 3]);
+            return Vertex::Point{ (a.x + b.x) / 2, (a.y + b.y) / 2 };
+        };
+        std::vector<Vertex::Point> run_sum(crossings.size(), { 0, 0 });
+        std::vector<unsigned int> run_size(crossings.size(), 0);
+        for (size_t i = 0; i < crossings.size(); i++) {
+            const unsigned int run = runs.find(i);
+            const Vertex::Point middle = edge_middle(i);
+            run_sum[run].x += middle.x;
+            run_sum[run].y += middle.y;
+            run_size[run]++;
+        }
+        std::vector<unsigned int> representative(crossings.size(), NONE);
+        std::vector<double> closest(crossings.size(), INFINITY);
+        for (size_t i = 0; i < crossings.size(); i++) {
+            const unsigned int run = runs.find(i);
+            const double offset = distance(edge_middle(i), { run_sum[run].x / run_size[run], run_sum[run].y / run_size[run] });
+            if (offset < closest[run]) {
+                closest[run] = offset;
+                representative[run] = i;
+            }
+        }
+        portals.clear();
+        for (size_t run = 0; run < crossings.size(); run++) {
+            if (representative[run] == NONE) {
+                continue;
+            }
+            const Crossing& crossing = crossings[representative[run]];
+            const unsigned int other = mesh.neighbor(crossing.triangle, crossing.side);
+            portals.push_back({ { crossing.triangle, other }, { clusters[crossing.triangle], clusters[other] }, edge_middle(representative[run]) });
+        }
+        cluster_portal_start.assign(cluster_total + 1, 0);
+        for (const Portal& portal : portals) {
+            cluster_portal_start[portal.clusters[0] + 1]++;
+            cluster_portal_start[portal.clusters[1] + 1]++;
+        }
+        std::partial_sum(cluster_portal_start.begin(), cluster_portal_start.end(), cluster_portal_start.begin());
+        cluster_portals.resize(cluster_portal_start.back());
+        {
+            std::vector<unsigned int> fill(cluster_portal_start.begin(), cluster_portal_start.end() - 1);
+            for (unsigned int i = 0; i < portals.size(); i++) {
+                cluster_portals[fill[portals[i].clusters[0]]++] = i;
+                cluster_portals[fill[portals[i].clusters[1]]++] = i;
+            }
+        }
+        const clock::time_point connected = clock::now();
+
+        // Costs: from each portal, a Dijkstra search inside each of its clusters until every other portal of that cluster is settled.
+        struct Found {
+            unsigned int from;
+            AbstractEdge edge;
+        };
+        std::vector<std::vector<Found>> found(std::max<size_t>(TriangleManipulator::chunk_count(cluster_total, 1), 1));
+        TriangleManipulator::parallel_steal(cluster_total, 1, [&](size_t worker, size_t begin, size_t end) {
+            for (unsigned int cluster = begin; cluster < end; cluster++) {
+                const unsigned int first = cluster_portal_start[cluster], last = cluster_portal_start[cluster + 1];
+                for (unsigned int from = first; from < last; from++) {
+                    const Portal& source = portals[cluster_portals[from]];
+                    const unsigned int start = portal_triangle(source, cluster);
+                    size_t remaining = last - first;
+                    SearchState& state = triangle_search;
+                    search_triangles(mesh, state, start, source.middle, NONE, source.middle, [&](unsigned int triangle) {
+                        return clusters[triangle] == cluster;
+                    }, [](const Vertex::Point&) {
+                        return 0.0;
+                    }, [&](unsigned int triangle) {
+                        // Portals are few per cluster, so a scan beats anything cleverer here.
+                        for (unsigned int to = first; to < last; to++) {
+                            remaining -= portal_triangle(portals[cluster_portals[to]], cluster) == triangle;
+                        }
+                        return remaining == 0;
+                    });
+                    for (unsigned int to = first; to < last; to++) {
+                        const Portal& target = portals[cluster_portals[to]];
+                        const unsigned int triangle = portal_triangle(target, cluster);
+                        if (to != from && state.reached(triangle)) {
+                            found[worker].push_back({ cluster_portals[from], { cluster_portals[to], cluster, state.cost[triangle] + distance(state.position[triangle], target.middle) } });
+                        }
+                    }
+                }
+            }
+        });
+        edge_start.assign(portals.size() + 1, 0);
+        for (const std::vector<Found>& list : found) {
+            for (const Found& edge : list) {
+                edge_start[edge.from + 1]++;
+            }
+        }
+        std::partial_sum(edge_start.begin(), edge_start.end(), edge_start.begin());
+        edges.resize(edge_start.back());
+        {
+            std::vector<unsigned int> fill(edge_start.begin(), edge_start.end() - 1);
+            for (const std::vector<Found>& list : found) {
+                for (const Found& edge : list) {
+                    edges[fill[edge.from]++] = edge.edge;
+                }
+            }
+        }
+        const clock::time_point costed = clock::now();
+
+        stats.clusters = cluster_total;
+        stats.portals = portals.size();
+        stats.abstract_edges = edges.size();
+        stats.cluster_seconds = std::chrono::duration<double>(clustered - build_start).count();
+        stats.portal_seconds = std::chrono::duration<double>(connected - clustered).count();
+        stats.cost_seconds = std::chrono::duration<double>(costed - connected).count();
+        stats.seconds = std::chrono::duration<double>(costed - build_start).count();
+    }
+
+    bool NavHierarchy::find_corridor(Vertex::Point start_point, unsigned int start, Vertex::Point goal_point, unsigned int goal, std::vector<unsigned int>& corridor) const {
+        corridor.clear();
+        if (clusters[start] == NONE || clusters[goal] == NONE) {
+            return false;
+        }
+        const unsigned int start_cluster = clusters[start], goal_cluster = clusters[goal];
+        if (start_cluster != goal_cluster) {
+            // Costs from start to its cluster's portals, and from goal to its cluster's.
+            SearchState& state = triangle_search;
+            const auto portal_costs = [&](unsigned int from, Vertex::Point from_point, unsigned int cluster, auto&& each) {
+                const unsigned int first = cluster_portal_start[cluster], last = cluster_portal_start[cluster + 1];
+                search_triangles(mesh, state, from, from_point, NONE, from_point, [&](unsigned int triangle) {
+                    return clusters[triangle] == cluster;
+                }, [](const Vertex::Point&) {
+                    return 0.0;
+                }, [](unsigned int) {
+                    return false;
+                });
+                for (unsigned int i = first; i < last; i++) {
+                    const Portal& portal = portals[cluster_portals[i]];
+                    const unsigned int triangle = portal_triangle(portal, cluster);
+                    if (state.reached(triangle)) {
+                        each(cluster_portals[i], state.cost[triangle] + distance(state.position[triangle], portal.middle));
+                    }
+                }
+            };
+            // The portal graph gets one extra node standing for the goal.
+            const unsigned int goal_node = portals.size();
+            SearchState& abstract = portal_search;
+            abstract.prepare(portals.size() + 1);
+            std::vector<std::pair<unsigned int, double>> goal_costs;
+            portal_costs(goal, goal_point, goal_cluster, [&](unsigned int portal, double cost) {
+                goal_costs.emplace_back(portal, cost);
+            });
+            std::sort(goal_costs.begin(), goal_costs.end());
+            portal_costs(start, start_point, start_cluster, [&](unsigned int portal, double cost) {
+                if (abstract.improve(portal, cost, portal)) {
+                    abstract.via[portal] = start_cluster;
+                    abstract.push(cost + distance(portals[portal].middle, goal_point), cost, portal);
+                }
+            });
+            bool reached = false;
+            while (!abstract.open.empty()) {
+                const OpenEntry current = abstract.pop();
+                if (current.cost > abstract.cost[current.node]) {
+                    continue;
+                }
+                if (current.node == goal_node) {
+                    reached = true;
+                    break;
+                }
+                for (unsigned int i = edge_start[current.node]; i < edge_start[current.node + 1]; i++) {
+                    const AbstractEdge& edge = edges[i];
+                    const double cost = current.cost + edge.cost;
+                    if (abstract.improve(edge.to, cost, current.node)) {
+                        abstract.via[edge.to] = edge.cluster;
+                        abstract.push(cost + distance(portals[edge.to].middle, goal_point), cost, edge.to);
+                    }
+                }
+                const auto to_goal = std::lower_bound(goal_costs.begin(), goal_costs.end(), std::pair<unsigned int, double>(current.node, -INFINITY));
+                if (to_goal != goal_costs.end() && to_goal->first == current.node) {
+                    const double cost = current.cost + to_goal->second;
+                    if (abstract.improve(goal_node, cost, current.node)) {
+                        abstract.push(cost, cost, goal_node);
+                    }
+                }
+            }
+            if (!reached) {
+                return false;
+            }
+            // Refine the route one leg at a time, each with a directed search inside the cluster the leg runs through.
+            std::vector<unsigned int>& route = route_portals;
+            route.clear();
+            for (unsigned int node = abstract.parent[goal_node];; node = abstract.parent[node]) {
+                route.push_back(node);
+                if (abstract.parent[node] == node) {
+                    break;
+                }
+            }
+            std::reverse(route.begin(), route.end());
+            std::vector<unsigned int>& leg = leg_corridor;
+            unsigned int from = start;
+            Vertex::Point from_point = start_point;
+            for (size_t i = 0; i <= route.size(); i++) {
+                const bool last = i == route.size();
+                const unsigned int cluster = last ? goal_cluster : abstract.via[route[i]];
+                if (i > 0) {
+                    from = portal_triangle(portals[route[i - 1]], cluster);
+                }
+                const unsigned int to = last ? goal : portal_triangle(portals[route[i]], cluster);
+                const Vertex::Point to_point = last ? goal_point : portals[route[i]].middle;
+                bool found = false;
+                search_triangles(mesh, state, from, from_point, to, to_point, [&](unsigned int triangle) {
+                    return clusters[triangle] == cluster;
+                }, [&](const Vertex::Point& position) {
+                    return distance(position, to_point);
+                }, [&](unsigned int triangle) {
+                    return found = triangle == to;
+                });
+                if (!found) {
+                    // Clusters are connected, so this is only a safety net.
+                    return mesh.find_corridor(start_point, start, goal_point, goal, corridor);
+                }
+                trace(state, from, to, leg);
+                corridor.insert(corridor.end(), leg.begin() + (!corridor.empty() && corridor.back() == leg.front()), leg.end());
+                from_point = to_point;
+            }
+            // Legs can double back through the same triangles either side of a portal. Cut those loops out, so the corridor is simple.
+            state.prepare(mesh.triangle_count());
+            size_t kept = 0;
+            for (size_t i = 0; i < corridor.size(); i++) {
+                const unsigned int triangle = corridor[i];
+                if (state.reached(triangle) && state.parent[triangle] < kept && corridor[state.parent[triangle]] == triangle) {
+                    kept = state.parent[triangle] + 1;
+                    continue;
+                }
+                state.stamp[triangle] = state.generation;
+                state.parent[triangle] = kept;
+                corridor[kept++] = triangle;
+            }
+            corridor.resize(kept);
+            return true;
+        }
+
+        SearchState& state = triangle_search;
+        bool found = false;
+        search_triangles(mesh, state, start, start_point, goal, goal_point, [&](unsigned int triangle) {
+            return clusters[triangle] == start_cluster;
+        }, [&](const Vertex::Point& position) {
+            return distance(position, goal_point);
+        }, [&](unsigned int triangle) {
+            return found = triangle == goal;
+        });
+        if (!found) {
+            return mesh.find_corridor(start_point, start, goal_point, goal, corridor);
+        }
+        trace(state, start, goal, corridor);
+        return true;
+    }
+
+    bool NavHierarchy::find_path(Vertex::Point start, Vertex::Point goal, std::vector<Vertex::Point>& path) const {
+        path.clear();
+        const std::optional<unsigned int> start_triangle = mesh.locate(start);
+        const std::optional<unsigned int> goal_triangle = mesh.locate(goal);
+        if (!start_triangle || !goal_triangle) {
+            return false;
+        }
+        thread_local std::vector<unsigned int> corridor;
+        if (!find_corridor(start, *start_triangle, goal, *goal_triangle, corridor)) {
+            return false;
+        }
+        mesh.pull_string(start, goal, corridor, path);
+        return true;
+    }
+}
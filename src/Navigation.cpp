@@ -0,0 +1,444 @@
+#include "TriangleManipulator/Navigation.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace PointLocation {
+    namespace {
+        inline std::uint64_t edge_key(unsigned int a, unsigned int b) {
+            return a < b ? (std::uint64_t(a) << 32) | b : (std::uint64_t(b) << 32) | a;
+        }
+
+        inline double distance(const Vertex::Point& a, const Vertex::Point& b) {
+            return std::hypot(a.x - b.x, a.y - b.y);
+        }
+
+        thread_local NavMesh::SearchBuffers search_buffers;
+    }
+
+    NavMesh::NavMesh(const GraphInfo& info, std::shared_ptr<const triangulateio> constraints) : info(info), corners(), neighbors(), centroids(), clearances(), walls(), wall_origin(), wall_cell_size(1), wall_columns(0), wall_rows(0), wall_cell_start(), wall_cells() {
+        // map_triangles sizes triangle_map to the base triangulation, and unlike triangulations it's there after a query only load.
+        const size_t count = info.triangle_map.size();
+        if (count == 0) {
+            throw std::runtime_error("NavMesh needs a locator that has had map_triangles run");
+        }
+        corners.resize(count * 3);
+        neighbors.assign(count * 3, -1);
+        centroids.resize(count);
+        const std::vector<Triangle>& triangles = info.planar_graph.all_triangles;
+        TriangleManipulator::parallel_for(count, 1 << 14, [&](size_t i) {
+            unsigned int a = triangles[i].vertex_one, b = triangles[i].vertex_two, c = triangles[i].vertex_three;
+            if (ccw(point(a), point(b), point(c)) < 0) {
+                std::swap(b, c);
+            }
+            corners[i * 3] = a;
+            corners[i * 3 + 1] = b;
+            corners[i * 3 + 2] = c;
+            centroids[i] = { (point(a).x + point(b).x + point(c).x) / 3, (point(a).y + point(b).y + point(c).y) / 3 };
+        });
+
+        std::vector<std::uint64_t> blocked;
+        if (constraints) {
+            const int* segment_ptr = constraints->segmentlist.get();
+            blocked.resize(constraints->numberofsegments);
+            for (size_t i = 0; i < blocked.size(); i++) {
+                blocked[i] = edge_key(segment_ptr[i * 2], segment_ptr[i * 2 + 1]);
+            }
+            std::sort(blocked.begin(), blocked.end());
+        }
+        // Sides of walkable triangles, by edge. The two sides of a shared edge end up next to each other.
+        std::vector<std::pair<std::uint64_t, unsigned int>> sides;
+        sides.reserve(count * 3);
+        for (unsigned int i = 0; i < count; i++) {
+            if (!walkable(i)) {
+                continue;
+            }
+            for (unsigned int side = 0; side < 3; side++) {
+                sides.emplace_back(edge_key(corners[i * 3 + (side + 1) % 3], corners[i * 3 + (side + 2) % 3]), i * 3 + side);
+            }
+        }
+        TriangleManipulator::parallel_sort(sides.begin(), sides.end());
+        for (size_t i = 0; i + 1 < sides.size(); i++) {
+            if (sides[i].first != sides[i + 1].first) {
+                continue;
+            }
+            if (!std::binary_search(blocked.begin(), blocked.end(), sides[i].first)) {
+                neighbors[sides[i].second] = sides[i + 1].second / 3;
+                neighbors[sides[i + 1].second] = sides[i].second / 3;
+            }
+            i++;
+        }
+        build_walls();
+        clearances.assign(count, 0);
+        TriangleManipulator::parallel_for(count, 1 << 12, [&](size_t i) {
+            if (walkable(i)) {
+                clearances[i] = wall_distance(centroids[i]);
+            }
+        });
+    }
+
+    void NavMesh::build_walls() {
+        double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (unsigned int i = 0; i < triangle_count(); i++) {
+            if (!walkable(i)) {
+                continue;
+            }
+            for (unsigned int side = 0; side < 3; side++) {
+                if (neighbor(i, side) < 0) {
+                    walls.emplace_back(corners[i * 3 + (side + 1) % 3], corners[i * 3 + (side + 2) % 3]);
+                }
+                const Vertex::Point& corner = point(corners[i * 3 + side]);
+                min_x = std::min(min_x, corner.x);
+                min_y = std::min(min_y, corner.y);
+                max_x = std::max(max_x, corner.x);
+                max_y = std::max(max_y, corner.y);
+            }
+        }
+        if (walls.empty()) {
+            return;
+        }
+        // Roughly one wall per cell.
+        const double width = max_x - min_x, height = max_y - min_y;
+        wall_cell_size = std::max(std::sqrt(width * height / walls.size()), std::max(width, height) / walls.size());
+        if (!(wall_cell_size > 0)) {
+            wall_cell_size = 1;
+        }
+        wall_origin = { min_x, min_y };
+        wall_columns = (unsigned int) (width / wall_cell_size) + 1;
+        wall_rows = (unsigned int) (height / wall_cell_size) + 1;
+        const auto for_each_cell = [&](const std::pair<unsigned int, unsigned int>& wall, auto&& func) {
+            const Vertex::Point& a = point(wall.first);
+            const Vertex::Point& b = point(wall.second);
+            const unsigned int first_column = (unsigned int) ((std::min(a.x, b.x) - min_x) / wall_cell_size);
+            const unsigned int last_column = std::min(wall_columns - 1, (unsigned int) ((std::max(a.x, b.x) - min_x) / wall_cell_size));
+            const unsigned int first_row = (unsigned int) ((std::min(a.y, b.y) - min_y) / wall_cell_size);
+            const unsigned int last_row = std::min(wall_rows - 1, (unsigned int) ((std::max(a.y, b.y) - min_y) / wall_cell_size));
+            for (unsigned int row = first_row; row <= last_row; row++) {
+                for (unsigned int column = first_column; column <= last_column; column++) {
+                    func(row * wall_columns + column);
+                }
+            }
+        };
+        // Count, prefix sum, fill.
+        wall_cell_start.assign(wall_columns * wall_rows + 1, 0);
+        for (const std::pair<unsigned int, unsigned int>& wall : walls) {
+            for_each_cell(wall, [&](unsigned int cell) {
+                wall_cell_start[cell + 1]++;
+            });
+        }
+        for (size_t cell = 1; cell < wall_cell_start.size(); cell++) {
+            wall_cell_start[cell] += wall_cell_start[cell - 1];
+        }
+        wall_cells.resize(wall_cell_start.back());
+        std::vector<unsigned int> fill(wall_cell_start.begin(), wall_cell_start.end() - 1);
+        for (unsigned int i = 0; i < walls.size(); i++) {
+            for_each_cell(walls[i], [&](unsigned int cell) {
+                wall_cells[fill[cell]++] = i;
+            });
+        }
+    }
+
+    double NavMesh::wall_distance(Vertex::Point point, double max_dist) const {
+        double best = INFINITY;
+        if (walls.empty()) {
+            return best;
+        }
+        const auto cell_of = [this](double offset, unsigned int cells) {
+            return (int) std::clamp(std::floor(offset / wall_cell_size), 0.0, (double) cells - 1);
+        };
+        const int column = cell_of(point.x - wall_origin.x, wall_columns), row = cell_of(point.y - wall_origin.y, wall_rows);
+        const auto check = [&](int c, int r) {
+            if (c < 0 || r < 0 || c >= (int) wall_columns || r >= (int) wall_rows) {
+                return;
+            }
+            const unsigned int cell = r * wall_columns + c;
+            for (unsigned int i = wall_cell_start[cell]; i < wall_cell_start[cell + 1]; i++) {
+                const Vertex::Point& a = this->point(walls[wall_cells[i]].first);
+                const Vertex::Point& b = this->point(walls[wall_cells[i]].second);
+                const double dx = b.x - a.x, dy = b.y - a.y, length = dx * dx + dy * dy;
+                const double t = length == 0 ? 0 : std::clamp(((point.x - a.x) * dx + (point.y - a.y) * dy) / length, 0.0, 1.0);
+                best = std::min(best, distance(point, { a.x + t * dx, a.y + t * dy }));
+            }
+        };
+        for (int ring = 0;; ring++) {
+            if (ring == 0) {
+                check(column, row);
+            } else {
+                for (int c = column - ring; c <= column + ring; c++) {
+                    check(c, row - ring);
+                    check(c, row + ring);
+                }
+                for (int r = row - ring + 1; r < row + ring; r++) {
+                    check(column - ring, r);
+                    check(column + ring, r);
+                }
+            }
+            // Every cell not searched yet is beyond one of the square's sides. Only sides with cells of the grid past them count.
+            double bound = INFINITY;
+            if (column - ring > 0) {
+                bound = std::min(bound, std::max(0.0, point.x - (wall_origin.x + (column - ring) * wall_cell_size)));
+            }
+            if (column + ring + 1 < (int) wall_columns) {
+                bound = std::min(bound, std::max(0.0, wall_origin.x + (column + ring + 1) * wall_cell_size - point.x));
+            }
+            if (row - ring > 0) {
+                bound = std::min(bound, std::max(0.0, point.y - (wall_origin.y + (row - ring) * wall_cell_size)));
+            }
+            if (row + ring + 1 < (int) wall_rows) {
+                bound = std::min(bound, std::max(0.0, wall_origin.y + (row + ring + 1) * wall_cell_size - point.y));
+            }
+            if (best <= bound || bound > max_dist) {
+                break;
+            }
+        }
+        return best <= max_dist ? best : INFINITY;
+    }
+
+    std::optional<unsigned int> NavMesh::locate(Vertex::Point point) const {
+        const std::optional<unsigned int> triangle = info.locate_base_triangle(point);
+        if (!triangle || !walkable(*triangle)) {
+            return std::nullopt;
+        }
+        return triangle;
+    }
+
+    bool NavMesh::find_corridor(unsigned int start, unsigned int goal, std::vector<unsigned int>& corridor) const {
+        return find_corridor(centroids[start], start, centroids[goal], goal, corridor);
+    }
+
+    bool NavMesh::find_corridor(Vertex::Point start_point, unsigned int start, Vertex::Point goal_point, unsigned int goal, std::vector<unsigned int>& corridor) const {
+        return find_corridor(start_point, start, goal_point, goal, corridor, search_buffers);
+    }
+
+    bool NavMesh::find_corridor(Vertex::Point start_point, unsigned int start, Vertex::Point goal_point, unsigned int goal, std::vector<unsigned int>& corridor, SearchBuffers& buffers) const {
+        corridor.clear();
+        buffers.prepare(triangle_count());
+        buffers.stamp[start] = buffers.generation;
+        buffers.cost[start] = 0;
+        buffers.parent[start] = start;
+        buffers.position[start] = start_point;
+        buffers.open.push_back({ distance(start_point, goal_point), 0, start });
+        while (!buffers.open.empty()) {
+            std::pop_heap(buffers.open.begin(), buffers.open.end(), std::greater<>());
+            const SearchBuffers::OpenEntry current = buffers.open.back();
+            buffers.open.pop_back();
+            if (current.cost > buffers.cost[current.triangle]) {
+                // Superseded by a cheaper entry.
+                continue;
+            }
+            if (current.triangle == goal) {
+                for (unsigned int triangle = goal; triangle != start; triangle = buffers.parent[triangle]) {
+                    corridor.push_back(triangle);
+                }
+                corridor.push_back(start);
+                std::reverse(corridor.begin(), corridor.end());
+                return true;
+            }
+            const Vertex::Point& from = buffers.position[current.triangle];
+            for (unsigned int side = 0; side < 3; side++) {
+                const int next = neighbor(current.triangle, side);
+                if (next < 0) {
+                    continue;
+                }
+                const Vertex::Point& a = point(corners[current.triangle * 3 + (side + 1) % 3]);
+                const Vertex::Point& b = point(corners[current.triangle * 3 + (side + 2) % 3]);
+                const Vertex::Point to = (unsigned int) next == goal ? goal_point : Vertex::Point{ (a.x + b.x) / 2, (a.y + b.y) / 2 };
+                const double cost = current.cost + distance(from, to);
+                if (buffers.stamp[next] == buffers.generation && buffers.cost[next] <= cost) {
+                    continue;
+                }
+                buffers.stamp[next] = buffers.generation;
+                buffers.cost[next] = cost;
+                buffers.parent[next] = current.triangle;
+                buffers.position[next] = to;
+                buffers.open.push_back({ cost + distance(to, goal_point), cost, (unsigned int) next });
+                std::push_heap(buffers.open.begin(), buffers.open.end(), std::greater<>());
+            }
+        }
+        return false;
+    }
+
+    size_t NavMesh::find_corridors(Vertex::Point start_point, unsigned int start, std::span<const unsigned int> goals, std::vector<unsigned int>& corridors, std::vector<size_t>& offsets) const {
+        return find_corridors(start_point, start, goals, corridors, offsets, search_buffers);
+    }
+
+    size_t NavMesh::find_corridors(Vertex::Point start_point, unsigned int start, std::span<const unsigned int> goals, std::vector<unsigned int>& corridors, std::vector<size_t>& offsets, SearchBuffers& buffers) const {
+        corridors.clear();
+        offsets.clear();
+        buffers.prepare(triangle_count());
+        buffers.goals.assign(goals.begin(), goals.end());
+        std::sort(buffers.goals.begin(), buffers.goals.end());
+        buffers.goals.erase(std::unique(buffers.goals.begin(), buffers.goals.end()), buffers.goals.end());
+        buffers.settled.assign(buffers.goals.size(), 0);
+        size_t remaining = buffers.goals.size();
+        buffers.stamp[start] = buffers.generation;
+        buffers.cost[start] = 0;
+        buffers.parent[start] = start;
+        buffers.position[start] = start_point;
+        buffers.open.push_back({ 0, 0, start });
+        while (remaining > 0 && !buffers.open.empty()) {
+            std::pop_heap(buffers.open.begin(), buffers.open.end(), std::greater<>());
+            const SearchBuffers::OpenEntry current = buffers.open.back();
+            buffers.open.pop_back();
+            if (current.cost > buffers.cost[current.triangle]) {
+                continue;
+            }
+            const auto goal = std::lower_bound(buffers.goals.begin(), buffers.goals.end(), current.triangle);
+            if (goal != buffers.goals.end() && *goal == current.triangle && !buffers.settled[goal - buffers.goals.begin()]) {
+                buffers.settled[goal - buffers.goals.begin()] = 1;
+                remaining--;
+            }
+            const Vertex::Point& from = buffers.position[current.triangle];
+            for (unsigned int side = 0; side < 3; side++) {
+                const int next = neighbor(current.triangle, side);
+                if (next < 0) {
+                    continue;
+                }
+                const Vertex::Point& a = point(corners[current.triangle * 3 + (side + 1) % 3]);
+                const Vertex::Point& b = point(corners[current.triangle * 3 + (side + 2) % 3]);
+                const Vertex::Point to = { (a.x + b.x) / 2, (a.y + b.y) / 2 };
+                const double cost = current.cost + distance(from, to);
+                if (buffers.stamp[next] == buffers.generation && buffers.cost[next] <= cost) {
+                    continue;
+                }
+                buffers.stamp[next] = buffers.generation;
+                buffers.cost[next] = cost;
+                buffers.parent[next] = current.triangle;
+                buffers.position[next] = to;
+                buffers.open.push_back({ cost, cost, (unsigned int) next });
+                std::push_heap(buffers.open.begin(), buffers.open.end(), std::greater<>());
+            }
+        }
+        size_t reached = 0;
+        offsets.push_back(0);
+        for (const unsigned int goal : goals) {
+            const auto found = std::lower_bound(buffers.goals.begin(), buffers.goals.end(), goal);
+            if (buffers.settled[found - buffers.goals.begin()]) {
+                const size_t first = corridors.size();
+                for (unsigned int triangle = goal; triangle != start; triangle = buffers.parent[triangle]) {
+                    corridors.push_back(triangle);
+                }
+                corridors.push_back(start);
+                std::reverse(corridors.begin() + first, corridors.end());
+                reached++;
+            }
+            offsets.push_back(corridors.size());
+        }
+        return reached;
+    }
+
+    bool NavMesh::find_path(Vertex::Point start, Vertex::Point goal, std::vector<Vertex::Point>& path) const {
+        path.clear();
+        const std::optional<unsigned int> start_triangle = locate(start);
+        const std::optional<unsigned int> goal_triangle = locate(goal);
+        if (!start_triangle || !goal_triangle) {
+            return false;
+        }
+        std::vector<unsigned int>& corridor = search_buffers.corridor;
+        if (!find_corridor(start, *start_triangle, goal, *goal_triangle, corridor)) {
+            return false;
+        }
+        pull_string(start, goal, corridor, path);
+        return true;
+    }
+
+    SegmentWalk NavMesh::segment_walk(Vertex::Point a, Vertex::Point b, std::vector<unsigned int>* visited) const {
+        if (visited != nullptr) {
+            visited->clear();
+        }
+        const std::optional<unsigned int> start = locate(a);
+        if (!start) {
+            return { true, std::nullopt, std::nullopt };
+        }
+        unsigned int triangle = *start;
+        int entered_from = -1;
+        // Every step moves strictly further along a to b, so this only guards against rounding sending the walk in circles.
+        for (size_t steps = 0; steps <= triangle_count(); steps++) {
+            if (visited != nullptr) {
+                visited->push_back(triangle);
+            }
+            const unsigned int* corner = triangle_corners(triangle);
+            int exit = -1;
+            for (unsigned int side = 0; side < 3; side++) {
+                const Vertex::Point& p = point(corner[(side + 1) % 3]);
+                const Vertex::Point& q = point(corner[(side + 2) % 3]);
+                // Leaving through p to q means b is past it, with p on the right of a to b and q on the left.
+                if ((entered_from >= 0 && neighbor(triangle, side) == entered_from) || ccw(p, q, b) >= 0 || ccw(a, b, p) > 0 || ccw(a, b, q) < 0) {
+                    continue;
+                }
+                // Two sides qualify only when the line runs through the corner they share. Squeezing past that corner needs both open,
+                // so a blocked one wins and stops the walk.
+                if (exit < 0 || neighbor(triangle, side) < 0) {
+                    exit = side;
+                }
+            }
+            if (exit < 0) {
+                return { false, triangle, std::nullopt };
+            }
+            const int next = neighbor(triangle, exit);
+            if (next < 0) {
+                return { true, triangle, std::pair(corner[(exit + 1) % 3], corner[(exit + 2) % 3]) };
+            }
+            entered_from = triangle;
+            triangle = next;
+        }
+        return { true, triangle, std::nullopt };
+    }
+
+    void NavMesh::pull_string(Vertex::Point start, Vertex::Point goal, std::span<const unsigned int> corridor, std::vector<Vertex::Point>& path) const {
+        path.clear();
+        path.push_back(start);
+        // Portal 0 is the start, portal i the edge from corridor[i - 1] into corridor[i], and the last one the goal.
+        // Facing out of a counter clockwise triangle through side s, its next corner is on the right and the one after on the left.
+        const size_t portals = corridor.size() + 1;
+        const auto portal = [&](size_t i, Vertex::Point& left, Vertex::Point& right) {
+            if (i + 1 == portals) {
+                left = right = goal;
+                return;
+            }
+            const unsigned int triangle = corridor[i - 1];
+            unsigned int side = 0;
+            while (neighbor(triangle, side) != (int) corridor[i]) {
+                side++;
+            }
+            right = point(corners[triangle * 3 + (side + 1) % 3]);
+            left = point(corners[triangle * 3 + (side + 2) % 3]);
+        };
+        Vertex::Point apex = start, left = start, right = start;
+        size_t apex_index = 0, left_index = 0, right_index = 0;
+        for (size_t i = 1; i < portals; i++) {
+            Vertex::Point portal_left, portal_right;
+            portal(i, portal_left, portal_right);
+            // Try to narrow the funnel from the right. If that crosses the left side, the left corner is the next waypoint.
+            // A side still sitting on the apex, as happens while portals fan around it, doesn't constrain anything yet.
+            if (ccw(apex, right, portal_right) >= 0) {
+                if (apex == right || apex == left || ccw(apex, left, portal_right) < 0) {
+                    right = portal_right;
+                    right_index = i;
+                } else {
+                    path.push_back(left);
+                    apex = right = left;
+                    apex_index = right_index = left_index;
+                    i = apex_index;
+                    continue;
+                }
+            }
+            if (ccw(apex, left, portal_left) <= 0) {
+                if (apex == left || apex == right || ccw(apex, right, portal_left) > 0) {
+                    left = portal_left;
+                    left_index = i;
+                } else {
+                    path.push_back(right);
+                    apex = left = right;
+                    apex_index = left_index = right_index;
+                    i = apex_index;
+                    continue;
+                }
+            }
+        }
+        if (!(path.back() == goal)) {
+            path.push_back(goal);
+        }
+    }
+}
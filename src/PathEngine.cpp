@@ -0,0 +1,139 @@
+#include "TriangleManipulator/PathEngine.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace PointLocation {
+    namespace {
+        constexpr unsigned int NOT_LOCATED = static_cast<unsigned int>(-1);
+    }
+
+    PathEngine::PathEngine(const NavMesh& mesh) : mesh(mesh), scratch(), start_triangles(), goal_triangles(), order(), groups(), latencies(), on_batch() {}
+
+    void PathEngine::find_paths(std::span<const PathRequest> requests, PathBatch& out) {
+        using clock = std::chrono::steady_clock;
+        const clock::time_point batch_start = clock::now();
+        const bool timed = static_cast<bool>(on_batch);
+        const size_t count = requests.size();
+        out.slots.assign(count, { 0, false, 0, 0 });
+        start_triangles.resize(count);
+        goal_triangles.resize(count);
+        TriangleManipulator::parallel_for(count, 1 << 10, [&](size_t i) {
+            start_triangles[i] = mesh.locate(requests[i].start).value_or(NOT_LOCATED);
+            goal_triangles[i] = mesh.locate(requests[i].goal).value_or(NOT_LOCATED);
+        });
+        // Sort by start then goal, so each group is a run, and repeated goals within it are next to each other.
+        order.resize(count);
+        for (std::uint32_t i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        TriangleManipulator::parallel_sort(order.begin(), order.end(), [this](std::uint32_t first, std::uint32_t second) {
+            return std::pair(start_triangles[first], goal_triangles[first]) < std::pair(start_triangles[second], goal_triangles[second]);
+        });
+        groups.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (i == 0 || start_triangles[order[i]] != start_triangles[order[i - 1]]) {
+                groups.push_back(i);
+            }
+        }
+        const size_t group_count = groups.size();
+        groups.push_back(count);
+        if (timed) {
+            // Requests never searched for keep the -1, and stay out of the percentiles.
+            latencies.assign(count, -1);
+        }
+
+        const size_t workers = std::max<size_t>(TriangleManipulator::chunk_count(group_count, 1), 1);
+        if (scratch.size() < workers) {
+            scratch.resize(workers);
+        }
+        out.arenas.resize(std::max(out.arenas.size(), workers));
+        for (std::vector<Vertex::Point>& arena : out.arenas) {
+            arena.clear();
+        }
+        TriangleManipulator::parallel_steal(group_count, 1, [&](size_t worker, size_t begin, size_t end) {
+            WorkerScratch& local = scratch[worker];
+            std::vector<Vertex::Point>& arena = out.arenas[worker];
+            for (size_t group = begin; group < end; group++) {
+                const clock::time_point group_start = timed ? clock::now() : clock::time_point();
+                const size_t first = groups[group], last = groups[group + 1];
+                const unsigned int start = start_triangles[order[first]];
+                if (start == NOT_LOCATED) {
+                    continue;
+                }
+                local.goals.clear();
+                for (size_t i = first; i < last; i++) {
+                    const unsigned int goal = goal_triangles[order[i]];
+                    if (goal != NOT_LOCATED && (local.goals.empty() || local.goals.back() != goal)) {
+                        local.goals.push_back(goal);
+                    }
+                }
+                if (local.goals.empty()) {
+                    continue;
+                }
+                const PathRequest& leader = requests[order[first]];
+                if (local.goals.size() >= shared_search_goals) {
+                    mesh.find_corridors(leader.start, start, local.goals, local.corridors, local.offsets, local.search);
+                } else {
+                    // Few enough goals that a directed search per goal expands less than one search to all of them.
+                    local.corridors.clear();
+                    local.offsets.assign(1, 0);
+                    for (size_t i = first, goal_index = 0; goal_index < local.goals.size(); i++) {
+                        if (goal_triangles[order[i]] != local.goals[goal_index]) {
+                            continue;
+                        }
+                        const PathRequest& request = requests[order[i]];
+                        mesh.find_corridor(request.start, start, request.goal, local.goals[goal_index], local.corridor, local.search);
+                        local.corridors.insert(local.corridors.end(), local.corridor.begin(), local.corridor.end());
+                        local.offsets.push_back(local.corridors.size());
+                        goal_index++;
+                    }
+                }
+                for (size_t i = first, goal_index = 0; i < last; i++) {
+                    const std::uint32_t request = order[i];
+                    const unsigned int goal = goal_triangles[request];
+                    if (goal != NOT_LOCATED) {
+                        while (local.goals[goal_index] != goal) {
+                            goal_index++;
+                        }
+                        const std::span<const unsigned int> corridor(local.corridors.data() + local.offsets[goal_index], local.offsets[goal_index + 1] - local.offsets[goal_index]);
+                        if (!corridor.empty()) {
+                            mesh.pull_string(requests[request].start, requests[request].goal, corridor, local.path);
+                            out.slots[request] = { (std::uint32_t) worker, true, arena.size(), local.path.size() };
+                            arena.insert(arena.end(), local.path.begin(), local.path.end());
+                        }
+                        if (timed) {
+                            latencies[request] = std::chrono::duration<double>(clock::now() - group_start).count();
+                        }
+                    }
+                }
+            }
+        });
+
+        if (!timed) {
+            return;
+        }
+        PathBatchStats stats{};
+        stats.requests = count;
+        stats.found = std::count_if(out.slots.begin(), out.slots.end(), [](const PathBatch::Slot& slot) {
+            return slot.found;
+        });
+        stats.start_groups = group_count;
+        stats.workers = workers;
+        stats.seconds = std::chrono::duration<double>(clock::now() - batch_start).count();
+        stats.requests_per_second = stats.seconds > 0 ? count / stats.seconds : 0;
+        std::erase_if(latencies, [](double latency) {
+            return latency < 0;
+        });
+        const auto percentile = [this](double fraction) {
+            const auto nth = latencies.begin() + std::min<size_t>(latencies.size() - 1, latencies.size() * fraction);
+            std::nth_element(latencies.begin(), nth, latencies.end());
+            return *nth;
+        };
+        if (!latencies.empty()) {
+            stats.p50_latency = percentile(0.5);
+            stats.p99_latency = percentile(0.99);
+        }
+        on_batch(stats);
+    }
+}
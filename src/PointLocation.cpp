@@ -1,9 +1,16 @@
 #include "TriangleManipulator/PointLocation.hpp"
 #include "TriangleManipulator/ShapeManipulator.hpp"
 #include "TriangleManipulator/TriangleManipulator.hpp"
+#include "TriangleManipulator/MeshBundle.hpp"
+#include "TriangleManipulator/Topology.hpp"
+#include "TriangleManipulator/Parallel.hpp"
 #include "earcut.hpp"
 #include "fmt/os.h"
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <numeric>
 #include <unordered_map>
 
 // template class std::vector<PointLocation::Point>;
@@ -37,9 +44,9 @@ namespace PointLocation {
         real_graph->numberofpoints = graph->numberofpoints + 3;
         real_graph->numberofsegments = graph->numberofsegments + 3;
         // I may be allocating like 3x more memory than I need to lol
-        real_graph->pointlist = trimalloc<REAL>(real_graph->numberofpoints * 2);
-        real_graph->segmentlist = trimalloc<int>(real_graph->numberofsegments * 2);
-        real_graph->segmentmarkerlist = trimalloc<int>(real_graph->numberofsegments);
+        real_graph->pointlist = TriangleManipulator::allocate<REAL>(real_graph->numberofpoints * 2);
+        real_graph->segmentlist = TriangleManipulator::allocate<int>(real_graph->numberofsegments * 2);
+        real_graph->segmentmarkerlist = TriangleManipulator::allocate<int>(real_graph->numberofsegments);
         real_graph->numberoftriangles = graph->numberoftriangles;
         real_graph->numberofcorners = 3;
         real_graph->trianglelist = graph->trianglelist;
@@ -87,19 +94,30 @@ namespace PointLocation {
         real_graph->segmentmarkerlist.get()[graph->numberofsegments + 1] = 1;
         real_graph->segmentmarkerlist.get()[graph->numberofsegments + 2] = 1;
 
-        triangulate("pzeBPQN", real_graph, output, nullptr);
-        std::shared_ptr<triangulateio> empty = TriangleManipulator::create_instance();
+        triangulate("pzBPQN", real_graph, output, nullptr);
+        const TriangleManipulator::MeshTopology topology = TriangleManipulator::build_topology(output->trianglelist.get(), output->numberoftriangles, real_graph->numberofpoints);
         this->vertices.reserve(real_graph->numberofpoints);
         const REAL* output_point_ptr = real_graph->pointlist.get();
         for (size_t i = 0; i < real_graph->numberofpoints; i++) {
             this->add_vertex(output_point_ptr[i * 2], output_point_ptr[i * 2 + 1]);
         }
-        const int* output_edge_ptr = output->edgelist.get();
-        for (size_t i = 0; i < output->numberofedges; i++) {
-            this->connect_vertices(output_edge_ptr[i * 2], output_edge_ptr[i * 2 + 1]);
+        // Every edge comes out of the topology once, so there is nothing to check before adding it.
+        std::vector<unsigned int> degrees(this->vertices.size(), 0);
+        for (const unsigned int vertex : topology.edges) {
+            degrees[vertex]++;
         }
-        for (Vertex& vertex : this->vertices) {
-            vertex.triangles.reserve(vertex.neighs.size());
+        for (size_t i = 0; i < this->vertices.size(); i++) {
+            this->vertices[i].neighs.reserve(degrees[i]);
+        }
+        for (size_t i = 0; i < topology.edge_count(); i++) {
+            this->add_directed_edge(topology.edges[i * 2], topology.edges[i * 2 + 1]);
+            this->add_directed_edge(topology.edges[i * 2 + 1], topology.edges[i * 2]);
+        }
+        for (size_t i = 0; i < this->vertices.size(); i++) {
+            const std::span<const unsigned int> triangles = topology.triangles_around(i);
+            std::vector<unsigned int>& vertex_triangles = this->vertices[i].triangles;
+            vertex_triangles.reserve(this->vertices[i].neighs.size());
+            vertex_triangles.assign(triangles.begin(), triangles.end());
         }
         this->triangulations.emplace_back(output->numberoftriangles);
         // triangulation.reserve(output->numberoftriangles);
@@ -111,9 +129,6 @@ namespace PointLocation {
             unsigned int b = *output_triangle_ptr++;
             unsigned int c = *output_triangle_ptr++;
             this->all_triangles.emplace_back(a, b, c);
-            this->vertices[a].add_triangle(i);
-            this->vertices[b].add_triangle(i);
-            this->vertices[c].add_triangle(i);
             // triangulation.emplace(i);
         }
     }
@@ -132,10 +147,10 @@ namespace PointLocation {
 
     inline void PlanarGraph::connect_vertices(unsigned int first_vertex, unsigned int second_vertex) {
         auto& first_neighs = this->vertices[first_vertex].neighs;
-        auto& second_neighs = this->vertices[second_vertex].neighs;
-        if ((std::find(first_neighs.begin(), first_neighs.end(), second_vertex) == first_neighs.end()) || (std::find(second_neighs.begin(), second_neighs.end(), first_vertex) == second_neighs.end())) {
+        // Edges are always added both ways, so one side is enough to check.
+        if (std::find(first_neighs.begin(), first_neighs.end(), second_vertex) == first_neighs.end()) {
             first_neighs.emplace_back(second_vertex);
-            second_neighs.emplace_back(first_vertex);
+            this->vertices[second_vertex].neighs.emplace_back(first_vertex);
             // this->add_directed_edge(first_vertex, second_vertex);
             // this->add_directed_edge(second_vertex, first_vertex);
         }
@@ -321,6 +336,8 @@ namespace PointLocation {
     }
 
     void GraphInfo::process() {
+        load_topology();
+        query_nodes.clear();
         std::size_t last_run = 0;
         while (planar_graph.triangulations.back() > 1) {
             planar_graph.remove_vertices(planar_graph.find_independant_set(), directed_graph);
@@ -333,8 +350,54 @@ namespace PointLocation {
         directed_graph.root = planar_graph.all_triangles.size() - 1;
     }
 
-    void GraphInfo::read_from_binary_file(std::string filename) {
-        TriangleManipulator::binary_reader reader(filename.c_str());
+    /**
+     * @brief Where the sections skipped by a load_mode::query_only load live, so they can be read later.
+     */
+    struct DeferredTopology {
+        // Covers the whole locator, so array padding lines up the same way it did when it was written.
+        TriangleManipulator::binary_reader reader;
+        size_t vertices_offset;
+        size_t triangulations_offset;
+        TriangleManipulator::binary_reader at(size_t offset) const {
+            TriangleManipulator::binary_reader result = reader.sub_reader(0, reader.mapped_bytes().size());
+            result.pad_arrays(reader.pads_arrays());
+            result.skip(offset);
+            return result;
+        }
+    };
+
+    struct VertexHeader {
+        size_t triangles_size;
+        size_t neighs_size;
+        double x;
+        double y;
+        bool removed;
+        bool forbidden;
+    };
+
+    inline VertexHeader read_vertex_header(TriangleManipulator::binary_reader& reader) {
+        VertexHeader header;
+        header.triangles_size = reader.read<size_t>();
+        header.neighs_size = reader.read<size_t>();
+        header.x = reader.read<double>();
+        header.y = reader.read<double>();
+        header.removed = reader.read<bool>();
+        header.forbidden = reader.read<bool>();
+        return header;
+    }
+
+    void GraphInfo::read_from_binary_file(std::string filename, load_mode mode) {
+        TriangleManipulator::binary_reader reader(filename.c_str(), mode == load_mode::query_only ? TriangleManipulator::read_mode::mapped : TriangleManipulator::read_mode::buffered);
+        read_from_binary(reader, mode);
+        reader.close();
+    }
+    void GraphInfo::read_from_bundle(const TriangleManipulator::mesh_bundle& bundle, bool verify, load_mode mode) {
+        TriangleManipulator::binary_reader reader = bundle.section(TriangleManipulator::section_type::graph_info, verify);
+        read_from_binary(reader, mode);
+    }
+    void GraphInfo::read_from_binary(TriangleManipulator::binary_reader& reader, load_mode mode) {
+        const bool lazy = mode == load_mode::query_only && reader.is_mapped();
+        query_nodes.clear();
         directed_graph.root = reader.read<unsigned int>();
 
         size_t directed_graph_size = reader.read<size_t>();
@@ -343,39 +406,81 @@ namespace PointLocation {
 
         reader.read_array(directed_graph_entries.data(), directed_graph_size);
 
+        const size_t vertices_offset = reader.tell();
         auto& vertices = planar_graph.vertices;
         size_t planar_graph_vertices_size = reader.read<size_t>();
         vertices.reserve(planar_graph_vertices_size);
 
         for (size_t i = 0; i < planar_graph_vertices_size; i++) {
-            size_t triangles_size = reader.read<size_t>();
-            size_t neighs_size = reader.read<size_t>();
-            double x = reader.read<double>();
-            double y = reader.read<double>();
-            bool removed = reader.read<bool>();
-            bool forbidden = reader.read<bool>();
-            Vertex& vertex = vertices.emplace_back(triangles_size, neighs_size, x, y, removed, forbidden);
-            reader.read_array(vertex.triangles.data(), triangles_size);
-            reader.read_array(vertex.neighs.data(), neighs_size);
+            const VertexHeader header = read_vertex_header(reader);
+            if (lazy) {
+                vertices.emplace_back(header.x, header.y, header.removed, header.forbidden);
+                reader.view_array<unsigned int>(header.triangles_size);
+                reader.view_array<unsigned int>(header.neighs_size);
+                continue;
+            }
+            Vertex& vertex = vertices.emplace_back(header.triangles_size, header.neighs_size, header.x, header.y, header.removed, header.forbidden);
+            reader.read_array(vertex.triangles.data(), header.triangles_size);
+            reader.read_array(vertex.neighs.data(), header.neighs_size);
         }
         size_t triangle_count = reader.read<size_t>();
         auto& triangles = planar_graph.all_triangles;
         triangles.resize(triangle_count);
         reader.read_array(triangles.data(), triangle_count);
 
+        const size_t triangulations_offset = reader.tell();
         size_t triangulations_count = reader.read<size_t>();
         auto& triangulations = planar_graph.triangulations;
-        triangulations.resize(triangulations_count);
-        reader.read_array(triangulations.data(), triangulations_count);
+        if (lazy) {
+            reader.view_array<size_t>(triangulations_count);
+        } else {
+            triangulations.resize(triangulations_count);
+            reader.read_array(triangulations.data(), triangulations_count);
+        }
 
         reader.read(planar_graph.num_vertices);
         size_t map_size = reader.read<size_t>();
         triangle_map.resize(map_size);
         reader.read_array(triangle_map.data(), map_size);
-        reader.close();
+
+        deferred.reset();
+        if (lazy) {
+            TriangleManipulator::binary_reader whole = reader.sub_reader(0, reader.mapped_bytes().size());
+            whole.pad_arrays(reader.pads_arrays());
+            deferred = std::make_shared<DeferredTopology>(std::move(whole), vertices_offset, triangulations_offset);
+        }
+    }
+    void GraphInfo::load_topology() {
+        if (!deferred) {
+            return;
+        }
+        TriangleManipulator::binary_reader reader = deferred->at(deferred->vertices_offset);
+        auto& vertices = planar_graph.vertices;
+        reader.read<size_t>();
+        for (Vertex& vertex : vertices) {
+            const VertexHeader header = read_vertex_header(reader);
+            vertex.triangles.resize(header.triangles_size);
+            vertex.neighs.resize(header.neighs_size);
+            reader.read_array(vertex.triangles.data(), header.triangles_size);
+            reader.read_array(vertex.neighs.data(), header.neighs_size);
+        }
+        TriangleManipulator::binary_reader triangulations_reader = deferred->at(deferred->triangulations_offset);
+        auto& triangulations = planar_graph.triangulations;
+        triangulations.resize(triangulations_reader.read<size_t>());
+        triangulations_reader.read_array(triangulations.data(), triangulations.size());
+        deferred.reset();
     }
     void GraphInfo::write_to_binary_file(std::string filename) const {
         TriangleManipulator::binary_writer writer(filename.c_str());
+        write_to_binary(writer);
+        writer.close();
+    }
+    void GraphInfo::write_to_bundle(TriangleManipulator::bundle_writer& bundle) const {
+        bundle.add_section(TriangleManipulator::section_type::graph_info, [this](TriangleManipulator::binary_writer& writer) {
+            write_to_binary(writer);
+        });
+    }
+    void GraphInfo::write_to_binary(TriangleManipulator::binary_writer& writer) const {
         writer.write(directed_graph.root);
 
         writer.write(directed_graph.graph.size());
@@ -383,33 +488,206 @@ namespace PointLocation {
 
         const auto& vertices = planar_graph.vertices;
         writer.write(vertices.size());
-        for (size_t i = 0; i < vertices.size(); i++) {
-            const Vertex& vertex = vertices[i];
-            writer.write(vertex.triangles.size());
-            writer.write(vertex.neighs.size());
+        if (deferred) {
+            // Still lazy: copy the topology straight across from the file it came from.
+            TriangleManipulator::binary_reader topology = deferred->at(deferred->vertices_offset);
+            topology.read<size_t>();
+            for (size_t i = 0; i < vertices.size(); i++) {
+                const VertexHeader header = read_vertex_header(topology);
+                const std::span<const unsigned int> vertex_triangles = topology.view_array<unsigned int>(header.triangles_size);
+                const std::span<const unsigned int> vertex_neighs = topology.view_array<unsigned int>(header.neighs_size);
+                writer.write(header.triangles_size);
+                writer.write(header.neighs_size);
+
+                writer.write(vertices[i].point.x);
+                writer.write(vertices[i].point.y);
+
+                writer.write(vertices[i].removed);
+                writer.write(vertices[i].forbidden);
+
+                writer.write_array(vertex_triangles.data(), vertex_triangles.size());
+                writer.write_array(vertex_neighs.data(), vertex_neighs.size());
+            }
+        } else {
+            for (size_t i = 0; i < vertices.size(); i++) {
+                const Vertex& vertex = vertices[i];
+                writer.write(vertex.triangles.size());
+                writer.write(vertex.neighs.size());
 
-            writer.write(vertex.point.x);
-            writer.write(vertex.point.y);
+                writer.write(vertex.point.x);
+                writer.write(vertex.point.y);
 
-            writer.write(vertex.removed);
-            writer.write(vertex.forbidden);
+                writer.write(vertex.removed);
+                writer.write(vertex.forbidden);
 
-            writer.write_array(vertex.triangles.data(), vertex.triangles.size());
-            writer.write_array(vertex.neighs.data(), vertex.neighs.size());
+                writer.write_array(vertex.triangles.data(), vertex.triangles.size());
+                writer.write_array(vertex.neighs.data(), vertex.neighs.size());
+            }
         }
 
         writer.write(planar_graph.all_triangles.size());
         writer.write_array(planar_graph.all_triangles.data(), planar_graph.all_triangles.size());
 
-        writer.write(planar_graph.triangulations.size());
-        writer.write_array(planar_graph.triangulations.data(), planar_graph.triangulations.size());
+        if (deferred) {
+            TriangleManipulator::binary_reader topology = deferred->at(deferred->triangulations_offset);
+            const size_t triangulations_count = topology.read<size_t>();
+            const std::span<const size_t> triangulations = topology.view_array<size_t>(triangulations_count);
+            writer.write(triangulations_count);
+            writer.write_array(triangulations.data(), triangulations.size());
+        } else {
+            writer.write(planar_graph.triangulations.size());
+            writer.write_array(planar_graph.triangulations.data(), planar_graph.triangulations.size());
+        }
 
         writer.write(planar_graph.num_vertices);
         writer.write(this->triangle_map.size());
         writer.write_array(this->triangle_map.data(), this->triangle_map.size());
-        writer.close();
     }
     std::optional<unsigned int> GraphInfo::locate_point(Vertex::Point point) const {
+        const std::optional<unsigned int> base = locate_base_triangle(point);
+        if (!base || triangle_map[*base] == -1) {
+            return std::nullopt;
+        }
+        return triangle_map[*base];
+    }
+    namespace {
+        constexpr unsigned int MAX_LOCATE_GROUP = 64;
+
+        inline bool node_contains_point(const Vertex::Point& point, const QueryNode& node) {
+            return point_inside_triangle(point, node.corners[0], node.corners[1], node.corners[2]);
+        }
+
+        // The lines a descent that just reached node reads next: its children block and its shortcut.
+        inline void prefetch_next(const QueryNode* base, const QueryNode* node) {
+            for (unsigned int i = 0; i < node->child_count; i++) {
+                __builtin_prefetch(base + node->first_child + i);
+            }
+            if (node->shortcut != 0) {
+                __builtin_prefetch(base + node->shortcut);
+            }
+        }
+
+        // One descent in flight: the node it has reached, whose children it tests next.
+        struct LocateLane {
+            const QueryNode* node;
+            size_t query;
+        };
+
+        // Round robin over up to group descents of the query layout, AMAC style. Each step moves one level and prefetches the next.
+        size_t locate_interleaved(const std::vector<QueryNode>& nodes, const std::vector<unsigned int>& triangle_map, std::span<const Vertex::Point> points,
+                                  std::span<unsigned int> out, size_t begin, size_t end, unsigned int group) {
+            const QueryNode* base = nodes.data();
+            const QueryNode& root = nodes.front();
+            size_t found = 0;
+            size_t next = begin;
+            const auto finish = [&](size_t query, unsigned int triangle) {
+                const unsigned int mapped = triangle < triangle_map.size() ? triangle_map[triangle] : static_cast<unsigned int>(-1);
+                out[query] = mapped;
+                found += mapped != static_cast<unsigned int>(-1);
+            };
+            // Give a lane the next query that needs a descent, settling the ones that don't on the way.
+            const auto start = [&](LocateLane& lane) {
+                while (next < end) {
+                    const size_t query = next++;
+                    if (!node_contains_point(points[query], root)) {
+                        out[query] = static_cast<unsigned int>(-1);
+                    } else if (root.child_count == 0) {
+                        finish(query, root.triangle);
+                    } else {
+                        lane = { base, query };
+                        prefetch_next(base, base);
+                        return true;
+                    }
+                }
+                return false;
+            };
+            LocateLane lanes[MAX_LOCATE_GROUP];
+            unsigned int active = 0;
+            while (active < group && start(lanes[active])) {
+                active++;
+            }
+            while (active > 0) {
+                for (unsigned int i = 0; i < active;) {
+                    LocateLane& lane = lanes[i];
+                    const Vertex::Point& point = points[lane.query];
+                    const QueryNode* node = lane.node;
+                    const QueryNode* hit = nullptr;
+                    if (node->shortcut != 0 && node_contains_point(point, base[node->shortcut])) {
+                        hit = base + node->shortcut;
+                    } else {
+                        const QueryNode* child = base + node->first_child;
+                        const QueryNode* last = child + node->child_count;
+                        while (child != last && !node_contains_point(point, *child)) {
+                            child++;
+                        }
+                        hit = child != last ? child : nullptr;
+                    }
+                    if (hit != nullptr && hit->child_count != 0) {
+                        lane.node = hit;
+                        prefetch_next(base, hit);
+                        i++;
+                        continue;
+                    }
+                    if (hit == nullptr) {
+                        out[lane.query] = static_cast<unsigned int>(-1);
+                    } else {
+                        finish(lane.query, hit->triangle);
+                    }
+                    // Refill the lane, or close the gap with the last one and step that next.
+                    if (start(lane)) {
+                        i++;
+                    } else {
+                        lane = lanes[--active];
+                    }
+                }
+            }
+            return found;
+        }
+    }
+
+    size_t GraphInfo::locate_points(std::span<const Vertex::Point> points, std::span<unsigned int> out, unsigned int group) const {
+        if (out.size() < points.size()) {
+            throw std::runtime_error(fmt::format("{} points to locate, but only room for {} results", points.size(), out.size()));
+        }
+        group = std::clamp(group, 1u, MAX_LOCATE_GROUP);
+        std::vector<size_t> found(TriangleManipulator::chunk_count(points.size(), 1 << 12), 0);
+        TriangleManipulator::parallel_chunks(points.size(), 1 << 12, [&](size_t chunk, size_t begin, size_t end) {
+            if (!query_nodes.empty()) {
+                found[chunk] = locate_interleaved(query_nodes, triangle_map, points, out, begin, end, group);
+                return;
+            }
+            for (size_t i = begin; i < end; i++) {
+                const std::optional<unsigned int> triangle = locate_point(points[i]);
+                out[i] = triangle.value_or(static_cast<unsigned int>(-1));
+                found[chunk] += triangle.has_value();
+            }
+        });
+        return std::accumulate(found.begin(), found.end(), size_t(0));
+    }
+
+    std::optional<unsigned int> GraphInfo::locate_base_triangle(Vertex::Point point) const {
+        if (!query_nodes.empty()) {
+            const QueryNode* node = query_nodes.data();
+            if (!node_contains_point(point, *node)) {
+                return std::nullopt;
+            }
+            while (node->child_count != 0) {
+                if (node->shortcut != 0 && node_contains_point(point, query_nodes[node->shortcut])) {
+                    node = query_nodes.data() + node->shortcut;
+                    continue;
+                }
+                const QueryNode* child = query_nodes.data() + node->first_child;
+                const QueryNode* last = child + node->child_count;
+                while (child != last && !point_inside_triangle(point, child->corners[0], child->corners[1], child->corners[2])) {
+                    child++;
+                }
+                if (child == last) {
+                    return std::nullopt;
+                }
+                node = child;
+            }
+            return node->triangle;
+        }
         if (!triangle_contains_point(point, planar_graph.all_triangles[directed_graph.root])) {
             return std::nullopt;
         }
@@ -418,10 +696,7 @@ namespace PointLocation {
             prev = last_checked;
             auto [first, last] = directed_graph.neighbhors(last_checked);
             if (std::distance(first, last) == 0) {
-                if (triangle_map[last_checked] == -1) {
-                    return std::nullopt;
-                }
-                return triangle_map[last_checked];
+                return last_checked;
             }
             for (auto current = first;current != last; current++) {
                 auto child = current->second;
@@ -437,9 +712,256 @@ namespace PointLocation {
         // With no gaps. Thus... it should be impossible.
         return std::nullopt;
     }
+    namespace {
+        /**
+         * @brief Which DAG nodes a range query has already been to. A node can have several parents, and stamps mean nothing needs clearing between queries.
+         */
+        struct VisitedStamps {
+            std::vector<std::uint32_t> stamp;
+            std::vector<unsigned int> stack;
+            // Min heap of (distance, node) for nearest_located_triangle.
+            std::vector<std::pair<double, unsigned int>> heap;
+            std::uint32_t generation = 0;
+            inline void prepare(size_t nodes) {
+                if (stamp.size() < nodes) {
+                    stamp.resize(nodes, 0);
+                }
+                if (++generation == 0) {
+                    std::fill(stamp.begin(), stamp.end(), 0);
+                    generation = 1;
+                }
+                stack.clear();
+                heap.clear();
+            }
+            inline bool visit(unsigned int node) {
+                if (stamp[node] == generation) {
+                    return false;
+                }
+                stamp[node] = generation;
+                return true;
+            }
+        };
+
+        thread_local VisitedStamps visited_stamps;
+
+        inline bool inside_or_on(const Vertex::Point& p, const Vertex::Point& a, const Vertex::Point& b, const Vertex::Point& c) {
+            const double first = ccw(a, b, p), second = ccw(b, c, p), third = ccw(c, a, p);
+            return (first >= 0 && second >= 0 && third >= 0) || (first <= 0 && second <= 0 && third <= 0);
+        }
+
+        inline bool segments_touch(const Vertex::Point& a, const Vertex::Point& b, const Vertex::Point& c, const Vertex::Point& d) {
+            const double d1 = ccw(c, d, a), d2 = ccw(c, d, b), d3 = ccw(a, b, c), d4 = ccw(a, b, d);
+            if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) {
+                return true;
+            }
+            const auto on = [](const Vertex::Point& p, const Vertex::Point& q, const Vertex::Point& r) {
+                return std::min(p.x, q.x) <= r.x && r.x <= std::max(p.x, q.x) && std::min(p.y, q.y) <= r.y && r.y <= std::max(p.y, q.y);
+            };
+            return (d1 == 0 && on(c, d, a)) || (d2 == 0 && on(c, d, b)) || (d3 == 0 && on(a, b, c)) || (d4 == 0 && on(a, b, d));
+        }
+
+        inline Vertex::Point closest_on_segment(const Vertex::Point& p, const Vertex::Point& a, const Vertex::Point& b) {
+            const double dx = b.x - a.x, dy = b.y - a.y;
+            const double length = dx * dx + dy * dy;
+            if (length == 0) {
+                return a;
+            }
+            const double t = std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / length, 0.0, 1.0);
+            return { a.x + t * dx, a.y + t * dy };
+        }
+
+        /**
+         * @brief The point of a closed triangle closest to p.
+         */
+        inline Vertex::Point closest_on_triangle(const Vertex::Point& p, const std::array<Vertex::Point, 3>& triangle) {
+            if (inside_or_on(p, triangle[0], triangle[1], triangle[2])) {
+                return p;
+            }
+            Vertex::Point best = triangle[0];
+            double best_distance = INFINITY;
+            for (size_t side = 0; side < 3; side++) {
+                const Vertex::Point candidate = closest_on_segment(p, triangle[side], triangle[(side + 1) % 3]);
+                const double distance = std::hypot(candidate.x - p.x, candidate.y - p.y);
+                if (distance < best_distance) {
+                    best = candidate;
+                    best_distance = distance;
+                }
+            }
+            return best;
+        }
+
+        /**
+         * @brief Even-odd test, so the polygon's orientation doesn't matter.
+         */
+        inline bool inside_polygon(const Vertex::Point& p, const std::vector<Vertex::Point>& polygon) {
+            bool inside = false;
+            for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+                const Vertex::Point& a = polygon[i];
+                const Vertex::Point& b = polygon[j];
+                if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) {
+                    inside = !inside;
+                }
+            }
+            return inside;
+        }
+
+        /**
+         * @brief Collect the mapped leaves under root whose triangles pass overlaps, only descending into nodes that pass it too.
+         */
+        template<typename Overlaps>
+        size_t descend(const GraphInfo& info, std::vector<unsigned int>& out, Overlaps&& overlaps) {
+            out.clear();
+            const std::vector<Triangle>& triangles = info.planar_graph.all_triangles;
+            if (triangles.empty()) {
+                return 0;
+            }
+            const auto corners = [&](unsigned int node) {
+                const Triangle& triangle = triangles[node];
+                const std::vector<Vertex>& vertices = info.planar_graph.vertices;
+                return std::array<Vertex::Point, 3>{ vertices[triangle.vertex_one].point, vertices[triangle.vertex_two].point, vertices[triangle.vertex_three].point };
+            };
+            VisitedStamps& visited = visited_stamps;
+            visited.prepare(triangles.size());
+            const unsigned int root = info.directed_graph.root;
+            visited.visit(root);
+            if (overlaps(corners(root))) {
+                visited.stack.push_back(root);
+            }
+            while (!visited.stack.empty()) {
+                const unsigned int node = visited.stack.back();
+                visited.stack.pop_back();
+                auto [first, last] = info.directed_graph.neighbhors(node);
+                if (first == last) {
+                    if (info.triangle_map[node] != static_cast<unsigned int>(-1)) {
+                        out.push_back(info.triangle_map[node]);
+                    }
+                    continue;
+                }
+                for (auto current = first; current != last; current++) {
+                    const unsigned int child = current->second;
+                    if (visited.visit(child) && overlaps(corners(child))) {
+                        visited.stack.push_back(child);
+                    }
+                }
+            }
+            return out.size();
+        }
+    }
+    size_t GraphInfo::query_rectangle(double min_x, double min_y, double max_x, double max_y, std::vector<unsigned int>& out) const {
+        const Vertex::Point rectangle[4] = { { min_x, min_y }, { max_x, min_y }, { max_x, max_y }, { min_x, max_y } };
+        return descend(*this, out, [&](const std::array<Vertex::Point, 3>& triangle) {
+            const auto [low_x, high_x] = std::minmax({ triangle[0].x, triangle[1].x, triangle[2].x });
+            const auto [low_y, high_y] = std::minmax({ triangle[0].y, triangle[1].y, triangle[2].y });
+            if (high_x < min_x || low_x > max_x || high_y < min_y || low_y > max_y) {
+                return false;
+            }
+            // Bounding boxes overlap, so the only separating axes left are the triangle's sides.
+            for (size_t i = 0; i < 3; i++) {
+                const Vertex::Point& a = triangle[i];
+                const Vertex::Point& b = triangle[(i + 1) % 3];
+                const double inside = ccw(a, b, triangle[(i + 2) % 3]);
+                bool separated = true;
+                for (const Vertex::Point& corner : rectangle) {
+                    const double side = ccw(a, b, corner);
+                    if (inside > 0 ? side >= 0 : side <= 0) {
+                        separated = false;
+                        break;
+                    }
+                }
+                if (separated) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+    size_t GraphInfo::query_polygon(const std::vector<Vertex::Point>& polygon, std::vector<unsigned int>& out) const {
+        if (polygon.size() < 3) {
+            out.clear();
+            return 0;
+        }
+        double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (const Vertex::Point& corner : polygon) {
+            min_x = std::min(min_x, corner.x);
+            min_y = std::min(min_y, corner.y);
+            max_x = std::max(max_x, corner.x);
+            max_y = std::max(max_y, corner.y);
+        }
+        return descend(*this, out, [&](const std::array<Vertex::Point, 3>& triangle) {
+            const auto [low_x, high_x] = std::minmax({ triangle[0].x, triangle[1].x, triangle[2].x });
+            const auto [low_y, high_y] = std::minmax({ triangle[0].y, triangle[1].y, triangle[2].y });
+            if (high_x < min_x || low_x > max_x || high_y < min_y || low_y > max_y) {
+                return false;
+            }
+            if (inside_polygon(triangle[0], polygon) || inside_or_on(polygon[0], triangle[0], triangle[1], triangle[2])) {
+                return true;
+            }
+            // Neither contains the other, so they only overlap if their boundaries cross.
+            for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+                for (size_t side = 0; side < 3; side++) {
+                    if (segments_touch(polygon[j], polygon[i], triangle[side], triangle[(side + 1) % 3])) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        });
+    }
+    std::optional<NearestTriangle> GraphInfo::nearest_located_triangle(Vertex::Point point, double max_dist) const {
+        const std::vector<Triangle>& triangles = planar_graph.all_triangles;
+        if (triangles.empty()) {
+            return std::nullopt;
+        }
+        // Points already on the mesh are the common case, and a plain descent settles those.
+        if (const std::optional<unsigned int> located = locate_point(point)) {
+            return NearestTriangle{ *located, point, 0 };
+        }
+        const auto corners = [&](unsigned int node) {
+            const Triangle& triangle = triangles[node];
+            const std::vector<Vertex>& vertices = planar_graph.vertices;
+            return std::array<Vertex::Point, 3>{ vertices[triangle.vertex_one].point, vertices[triangle.vertex_two].point, vertices[triangle.vertex_three].point };
+        };
+        const auto distance_to = [&](unsigned int node) {
+            const Vertex::Point closest = closest_on_triangle(point, corners(node));
+            return std::hypot(closest.x - point.x, closest.y - point.y);
+        };
+        // Every leaf is reachable through nodes containing its closest point, and those are no further away than it is.
+        // So a node's distance bounds every leaf under it, and the first mapped leaf off the heap is the nearest.
+        VisitedStamps& visited = visited_stamps;
+        visited.prepare(triangles.size());
+        std::vector<std::pair<double, unsigned int>>& heap = visited.heap;
+        const auto push = [&](unsigned int node) {
+            if (!visited.visit(node)) {
+                return;
+            }
+            const double distance = distance_to(node);
+            if (distance <= max_dist) {
+                heap.emplace_back(distance, node);
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+            }
+        };
+        push(directed_graph.root);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            const auto [distance, node] = heap.back();
+            heap.pop_back();
+            auto [first, last] = directed_graph.neighbhors(node);
+            if (first == last) {
+                if (triangle_map[node] != static_cast<unsigned int>(-1)) {
+                    return NearestTriangle{ triangle_map[node], closest_on_triangle(point, corners(node)), distance };
+                }
+                continue;
+            }
+            for (auto current = first; current != last; current++) {
+                push(current->second);
+            }
+        }
+        return std::nullopt;
+    }
     void GraphInfo::map_triangles(std::shared_ptr<triangulateio> others) {
         std::map<std::tuple<unsigned int, unsigned int, unsigned int>, unsigned int> temp_triangle_map = std::map<std::tuple<unsigned int, unsigned int, unsigned int>, unsigned int>();
 
+        load_topology();
         unsigned int num_triangles = others->numberoftriangles;
         const unsigned int* triangle_ptr = others->trianglelist.get();
         for (unsigned int i = 0; i < num_triangles; i++) {
@@ -463,6 +985,468 @@ namespace PointLocation {
             }
         }
     }
+
+    void GraphInfo::reorder(TriangleManipulator::space_filling_curve curve) {
+        load_topology();
+        query_nodes.clear();
+        std::vector<Triangle>& triangles = planar_graph.all_triangles;
+        const size_t total = triangles.size();
+        if (total < 2 || planar_graph.triangulations.empty()) {
+            return;
+        }
+        const size_t base = planar_graph.triangulations.front();
+        const auto& vertices = planar_graph.vertices;
+        std::vector<REAL> centroids(total * 2);
+        TriangleManipulator::parallel_for(total, 1 << 14, [&](size_t i) {
+            const Triangle& tri = triangles[i];
+            centroids[i * 2] = (vertices[tri.vertex_one].point.x + vertices[tri.vertex_two].point.x + vertices[tri.vertex_three].point.x) / 3;
+            centroids[i * 2 + 1] = (vertices[tri.vertex_one].point.y + vertices[tri.vertex_two].point.y + vertices[tri.vertex_three].point.y) / 3;
+        });
+        // A triangle's level is one more than its highest child's, so descents pass through the levels in order. Children are always older.
+        std::vector<unsigned int> levels(total, 0);
+        for (size_t i = base; i < total; i++) {
+            auto [first, last] = directed_graph.neighbhors(i);
+            for (auto child = first; child != last; child++) {
+                levels[i] = std::max(levels[i], levels[child->second] + 1);
+            }
+        }
+        // Level by level, then along the curve within each. Base triangles are level 0 and so keep ids below base; the root stays last.
+        std::vector<unsigned int> order;
+        order.reserve(total);
+        std::vector<unsigned int> by_level(total - 1);
+        std::iota(by_level.begin(), by_level.end(), 0);
+        std::stable_sort(by_level.begin(), by_level.end(), [&](unsigned int a, unsigned int b) {
+            return levels[a] < levels[b];
+        });
+        std::vector<REAL> level_centroids;
+        for (size_t begin = 0, end; begin < by_level.size(); begin = end) {
+            end = begin;
+            level_centroids.clear();
+            while (end < by_level.size() && levels[by_level[end]] == levels[by_level[begin]]) {
+                level_centroids.push_back(centroids[by_level[end] * 2]);
+                level_centroids.push_back(centroids[by_level[end] * 2 + 1]);
+                end++;
+            }
+            for (const unsigned int i : TriangleManipulator::spatial_order(level_centroids.data(), end - begin, curve)) {
+                order.push_back(by_level[begin + i]);
+            }
+        }
+        order.push_back(total - 1);
+        std::vector<unsigned int> new_id(total);
+        for (size_t i = 0; i < total; i++) {
+            new_id[order[i]] = i;
+        }
+
+        std::vector<Triangle> reordered(total);
+        TriangleManipulator::parallel_for(total, 1 << 14, [&](size_t i) {
+            reordered[i] = triangles[order[i]];
+        });
+        triangles.swap(reordered);
+        if (!triangle_map.empty()) {
+            std::vector<unsigned int> mapped(triangle_map.size());
+            for (size_t i = 0; i < mapped.size(); i++) {
+                mapped[i] = triangle_map[order[i]];
+            }
+            triangle_map.swap(mapped);
+        }
+        TriangleManipulator::parallel_for(planar_graph.vertices.size(), 1 << 12, [&](size_t i) {
+            std::vector<unsigned int>& vertex_triangles = planar_graph.vertices[i].triangles;
+            for (unsigned int& triangle : vertex_triangles) {
+                triangle = new_id[triangle];
+            }
+            std::sort(vertex_triangles.begin(), vertex_triangles.end());
+        });
+        // Children keep their order under each parent; locate_point takes the first one containing the point.
+        std::vector<std::pair<unsigned int, unsigned int>> edges(directed_graph.graph.begin(), directed_graph.graph.end());
+        for (auto& [parent, child] : edges) {
+            parent = new_id[parent];
+            child = new_id[child];
+        }
+        std::stable_sort(edges.begin(), edges.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+        directed_graph.graph.resize(edges.size());
+        std::copy(edges.begin(), edges.end(), directed_graph.graph.data());
+        directed_graph.root = total - 1;
+    }
+
+    namespace {
+        // Lays out the blocks of the nodes fewer than height steps below roots, van Emde Boas style.
+        struct VanEmdeBoasLayout {
+            const DirectedAcyclicGraph& dag;
+            std::vector<unsigned int>& block_order;
+            std::vector<std::uint8_t> placed;
+            std::vector<std::uint8_t> expanded;
+            std::vector<unsigned int> stamps;
+            unsigned int generation = 0;
+            void place(unsigned int node) {
+                auto [first, last] = dag.neighbhors(node);
+                if (first != last && !placed[node]) {
+                    placed[node] = 1;
+                    block_order.push_back(node);
+                }
+            }
+            void lay(const std::vector<unsigned int>& roots, unsigned int height) {
+                if (height <= 1) {
+                    for (const unsigned int root : roots) {
+                        place(root);
+                    }
+                    return;
+                }
+                const unsigned int top = height / 2;
+                lay(roots, top);
+                // The distinct nodes exactly top steps below roots, each of which then gets its own bottom tree.
+                std::vector<unsigned int> frontier = roots, next;
+                for (unsigned int step = 0; step < top; step++) {
+                    generation++;
+                    next.clear();
+                    for (const unsigned int node : frontier) {
+                        auto [first, last] = dag.neighbhors(node);
+                        for (auto child = first; child != last; child++) {
+                            if (stamps[child->second] != generation) {
+                                stamps[child->second] = generation;
+                                next.push_back(child->second);
+                            }
+                        }
+                    }
+                    frontier.swap(next);
+                }
+                for (const unsigned int node : frontier) {
+                    // A node reached earlier along a shorter path already had all of its levels laid out.
+                    if (!expanded[node]) {
+                        expanded[node] = 1;
+                        lay({ node }, height - top);
+                    }
+                }
+            }
+        };
+    }
+
+    void GraphInfo::build_query_layout(query_layout layout) {
+        load_topology();
+        query_nodes.clear();
+        layout_kind = layout;
+        const std::vector<Triangle>& triangles = planar_graph.all_triangles;
+        const size_t total = triangles.size();
+        if (total == 0) {
+            return;
+        }
+        const unsigned int root = directed_graph.root;
+        std::vector<unsigned int> block_order;
+        if (layout == query_layout::breadth_first) {
+            std::vector<std::uint8_t> seen(total, 0);
+            seen[root] = 1;
+            block_order.push_back(root);
+            for (size_t i = 0; i < block_order.size(); i++) {
+                auto [first, last] = directed_graph.neighbhors(block_order[i]);
+                for (auto child = first; child != last; child++) {
+                    auto [child_first, child_last] = directed_graph.neighbhors(child->second);
+                    if (!seen[child->second] && child_first != child_last) {
+                        seen[child->second] = 1;
+                        block_order.push_back(child->second);
+                    }
+                }
+            }
+        } else {
+            // Height is the longest path below each node. Children are always older, so one pass in id order finds it.
+            std::vector<unsigned int> heights(total, 0);
+            for (size_t i = 0; i < total; i++) {
+                auto [first, last] = directed_graph.neighbhors(i);
+                for (auto child = first; child != last; child++) {
+                    heights[i] = std::max(heights[i], heights[child->second] + 1);
+                }
+            }
+            VanEmdeBoasLayout veb{ directed_graph, block_order, std::vector<std::uint8_t>(total, 0), std::vector<std::uint8_t>(total, 0), std::vector<unsigned int>(total, 0) };
+            veb.lay({ root }, std::max(heights[root], 1u));
+            // Anything still missing goes at the end, so every node with children has a block.
+            for (size_t i = 0; i < total; i++) {
+                veb.place(i);
+            }
+        }
+
+        const auto& vertices = planar_graph.vertices;
+        const auto make_node = [&](unsigned int triangle) {
+            const Triangle& tri = triangles[triangle];
+            auto [first, last] = directed_graph.neighbhors(triangle);
+            return QueryNode{ { vertices[tri.vertex_one].point, vertices[tri.vertex_two].point, vertices[tri.vertex_three].point }, 0, static_cast<unsigned int>(std::distance(first, last)), triangle, 0 };
+        };
+        std::vector<unsigned int> block_start(total, 0);
+        query_nodes.reserve(directed_graph.graph.size() + 1);
+        query_nodes.push_back(make_node(root));
+        for (const unsigned int parent : block_order) {
+            block_start[parent] = query_nodes.size();
+            auto [first, last] = directed_graph.neighbhors(parent);
+            for (auto child = first; child != last; child++) {
+                query_nodes.push_back(make_node(child->second));
+            }
+        }
+        for (QueryNode& node : query_nodes) {
+            node.first_child = block_start[node.triangle];
+        }
+    }
+
+    size_t GraphInfo::descent_tests(std::span<const Vertex::Point> queries) const {
+        const auto& triangles = planar_graph.all_triangles;
+        std::vector<size_t> tests(TriangleManipulator::chunk_count(queries.size(), 1 << 12), 0);
+        TriangleManipulator::parallel_chunks(queries.size(), 1 << 12, [&](size_t chunk, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const Vertex::Point& point = queries[i];
+                tests[chunk]++;
+                if (!query_nodes.empty()) {
+                    const QueryNode* node = query_nodes.data();
+                    if (!node_contains_point(point, *node)) {
+                        continue;
+                    }
+                    while (node != nullptr && node->child_count != 0) {
+                        if (node->shortcut != 0) {
+                            tests[chunk]++;
+                            if (node_contains_point(point, query_nodes[node->shortcut])) {
+                                node = query_nodes.data() + node->shortcut;
+                                continue;
+                            }
+                        }
+                        const QueryNode* child = query_nodes.data() + node->first_child;
+                        const QueryNode* last = child + node->child_count;
+                        node = nullptr;
+                        for (; child != last; child++) {
+                            tests[chunk]++;
+                            if (node_contains_point(point, *child)) {
+                                node = child;
+                                break;
+                            }
+                        }
+                    }
+                    continue;
+                }
+                if (!triangle_contains_point(point, triangles[directed_graph.root])) {
+                    continue;
+                }
+                unsigned int current = directed_graph.root;
+                bool descended = true;
+                while (descended) {
+                    descended = false;
+                    auto [first, last] = directed_graph.neighbhors(current);
+                    for (auto child = first; child != last; child++) {
+                        tests[chunk]++;
+                        if (triangle_contains_point(point, triangles[child->second])) {
+                            current = child->second;
+                            descended = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+        return std::accumulate(tests.begin(), tests.end(), size_t(0));
+    }
+
+    std::vector<size_t> GraphInfo::profile_descents(std::span<const Vertex::Point> queries) const {
+        const auto& triangles = planar_graph.all_triangles;
+        const auto* edges = directed_graph.graph.data();
+        std::vector<size_t> counts(directed_graph.graph.size(), 0);
+        TriangleManipulator::parallel_chunks(queries.size(), 1 << 12, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const Vertex::Point& point = queries[i];
+                if (triangles.empty() || !triangle_contains_point(point, triangles[directed_graph.root])) {
+                    continue;
+                }
+                unsigned int current = directed_graph.root;
+                bool descended = true;
+                while (descended) {
+                    descended = false;
+                    auto [first, last] = directed_graph.neighbhors(current);
+                    for (auto child = first; child != last; child++) {
+                        if (triangle_contains_point(point, triangles[child->second])) {
+                            std::atomic_ref<size_t>(counts[&*child - edges]).fetch_add(1, std::memory_order_relaxed);
+                            current = child->second;
+                            descended = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+        return counts;
+    }
+
+    void GraphInfo::order_children(child_order order, std::span<const size_t> edge_counts) {
+        if (order == child_order::frequency && edge_counts.size() != directed_graph.graph.size()) {
+            throw std::runtime_error(fmt::format("{} edge counts given for a DAG with {} edges", edge_counts.size(), directed_graph.graph.size()));
+        }
+        const auto& triangles = planar_graph.all_triangles;
+        const auto& vertices = planar_graph.vertices;
+        const auto area = [&](unsigned int triangle) {
+            const Triangle& tri = triangles[triangle];
+            return std::abs(ccw(vertices[tri.vertex_one].point, vertices[tri.vertex_two].point, vertices[tri.vertex_three].point));
+        };
+        auto* edges = directed_graph.graph.data();
+        const size_t size = directed_graph.graph.size();
+        std::vector<size_t> ranks;
+        std::vector<std::pair<unsigned int, unsigned int>> sorted;
+        // Children of one node are a contiguous run of equal keys, so sorting within a run keeps the map sorted.
+        for (size_t begin = 0, end; begin < size; begin = end) {
+            end = begin + 1;
+            while (end < size && edges[end].first == edges[begin].first) {
+                end++;
+            }
+            ranks.resize(end - begin);
+            std::iota(ranks.begin(), ranks.end(), begin);
+            std::stable_sort(ranks.begin(), ranks.end(), [&](size_t a, size_t b) {
+                if (order == child_order::frequency && edge_counts[a] != edge_counts[b]) {
+                    return edge_counts[a] > edge_counts[b];
+                }
+                return area(edges[a].second) > area(edges[b].second);
+            });
+            sorted.clear();
+            for (const size_t rank : ranks) {
+                sorted.emplace_back(edges[rank].first, edges[rank].second);
+            }
+            std::copy(sorted.begin(), sorted.end(), edges + begin);
+        }
+        if (!query_nodes.empty()) {
+            build_query_layout(layout_kind);
+        }
+    }
+
+    size_t GraphInfo::add_shortcuts(std::span<const Vertex::Point> queries, const TrainingOptions& options) {
+        for (QueryNode& node : query_nodes) {
+            node.shortcut = 0;
+        }
+        // How many replayed descents reached each node of the layout.
+        std::vector<size_t> visits(query_nodes.size(), 0);
+        TriangleManipulator::parallel_chunks(queries.size(), 1 << 12, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const QueryNode* node = query_nodes.data();
+                while (node->child_count != 0) {
+                    const QueryNode* child = query_nodes.data() + node->first_child;
+                    const QueryNode* last = child + node->child_count;
+                    while (child != last && !node_contains_point(queries[i], *child)) {
+                        child++;
+                    }
+                    if (child == last) {
+                        break;
+                    }
+                    std::atomic_ref<size_t>(visits[child - query_nodes.data()]).fetch_add(1, std::memory_order_relaxed);
+                    node = child;
+                }
+            }
+        });
+        // Blocks are shared by every node for the same triangle, so everything is worked out per block, keyed by where it starts.
+        std::vector<size_t> block_visits(query_nodes.size(), 0);
+        for (const QueryNode& node : query_nodes) {
+            if (node.child_count != 0 && block_visits[node.first_child] == 0) {
+                for (unsigned int i = 0; i < node.child_count; i++) {
+                    block_visits[node.first_child] += visits[node.first_child + i];
+                }
+            }
+        }
+        // Follow the most taken child down from each block while the path stays likely. A shortcut to a node k levels down costs one test
+        // on every descent and saves the tests along the way on the ones that take it, so keep the node where that pays off most.
+        std::vector<unsigned int> block_shortcut(query_nodes.size(), 0);
+        std::vector<std::uint8_t> block_done(query_nodes.size(), 0);
+        size_t shortcuts = 0;
+        for (const QueryNode& node : query_nodes) {
+            if (node.child_count == 0 || block_done[node.first_child]) {
+                continue;
+            }
+            block_done[node.first_child] = 1;
+            if (block_visits[node.first_child] < options.min_shortcut_visits) {
+                continue;
+            }
+            double probability = 1;
+            double tests = 0;
+            double best_gain = 0;
+            unsigned int best = 0;
+            unsigned int block = node.first_child, count = node.child_count;
+            for (unsigned int depth = 1; count != 0 && block_visits[block] != 0; depth++) {
+                unsigned int taken = block;
+                for (unsigned int i = block + 1; i < block + count; i++) {
+                    if (visits[i] > visits[taken]) {
+                        taken = i;
+                    }
+                }
+                probability *= double(visits[taken]) / block_visits[block];
+                tests += taken - block + 1;
+                if (probability < options.min_shortcut_probability) {
+                    break;
+                }
+                const double gain = probability * (tests - 1) - (1 - probability);
+                if (depth >= 2 && gain > best_gain) {
+                    best_gain = gain;
+                    best = taken;
+                }
+                block = query_nodes[taken].first_child;
+                count = query_nodes[taken].child_count;
+            }
+            block_shortcut[node.first_child] = best;
+            shortcuts += best != 0;
+        }
+        for (QueryNode& node : query_nodes) {
+            if (node.child_count != 0) {
+                node.shortcut = block_shortcut[node.first_child];
+            }
+        }
+        return shortcuts;
+    }
+
+    TrainingStats GraphInfo::train(std::span<const Vertex::Point> queries, const TrainingOptions& options) {
+        TrainingStats stats{ queries.size(), 0, 0, 0 };
+        if (queries.empty() || planar_graph.all_triangles.empty()) {
+            return stats;
+        }
+        stats.tests_before = double(descent_tests(queries)) / queries.size();
+        if (options.order == child_order::frequency) {
+            order_children(options.order, profile_descents(queries));
+        } else {
+            order_children(options.order);
+        }
+        if (options.shortcuts) {
+            if (query_nodes.empty()) {
+                build_query_layout();
+            }
+            stats.shortcuts = add_shortcuts(queries, options);
+        }
+        stats.tests_after = double(descent_tests(queries)) / queries.size();
+        return stats;
+    }
+
+    LocateBenchmark benchmark_locate(const GraphInfo& info, std::span<const Vertex::Point> points) {
+        LocateBenchmark result{ points.size(), 0, 0, 0, 0 };
+        const auto start = std::chrono::steady_clock::now();
+        for (const Vertex::Point& point : points) {
+            result.found += info.locate_point(point).has_value();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.queries_per_second = result.seconds > 0 ? points.size() / result.seconds : 0;
+
+        // The same descent as locate_base_triangle, untimed, noting every triangle it reads.
+        const auto& triangles = info.planar_graph.all_triangles;
+        double strides = 0;
+        size_t steps = 0;
+        for (const Vertex::Point& point : points) {
+            unsigned int current = info.directed_graph.root, last_read = current;
+            if (!info.triangle_contains_point(point, triangles[current])) {
+                continue;
+            }
+            bool descended = true;
+            while (descended) {
+                descended = false;
+                auto [first, last] = info.directed_graph.neighbhors(current);
+                for (auto child = first; child != last; child++) {
+                    strides += std::abs(double(child->second) - double(last_read)) * sizeof(Triangle);
+                    steps++;
+                    last_read = child->second;
+                    if (info.triangle_contains_point(point, triangles[child->second])) {
+                        current = child->second;
+                        descended = true;
+                        break;
+                    }
+                }
+            }
+        }
+        result.mean_stride = steps > 0 ? strides / steps : 0;
+        return result;
+    }
 }
 
 namespace mapbox {
@@ -1,6 +1,12 @@
 #include "TriangleManipulator/ShapeManipulator.hpp"
 #include "TriangleManipulator/TriangleManipulator.hpp"
 #include <iostream>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <tuple>
 #include <unordered_set>
 
 template class std::vector<std::vector<PointLocation::Line>*>;
@@ -15,137 +21,519 @@ namespace ShapeManipulator {
         return find_points_inside(triangle_object);
     }
     std::shared_ptr<std::vector<double>> find_points_inside(std::shared_ptr<triangulateio> triangle_object) {
+        // Existing holes are eaten by the triangulation itself, so only regions that are still open get a point.
         std::shared_ptr<triangulateio> input = std::shared_ptr<triangulateio>(new triangulateio(*triangle_object));
-        std::shared_ptr<std::vector<double>> holes = std::shared_ptr<std::vector<double>>(new std::vector<double>());
+        std::shared_ptr<triangulateio> output = TriangleManipulator::create_instance();
+        std::shared_ptr<triangulateio> vorout = TriangleManipulator::create_instance();
+        triangulate("pznQ", input, output, vorout);
+
+        const size_t num_triangles = output->numberoftriangles;
+        const unsigned int* triangle_ptr = output->trianglelist.get();
+        const int* neighbor_ptr = output->neighborlist.get();
+        const int* segment_ptr = output->segmentlist.get();
+        const REAL* point_ptr = output->pointlist.get();
+        const auto edge_key = [](unsigned int a, unsigned int b) {
+            return a < b ? (std::uint64_t(a) << 32) | b : (std::uint64_t(b) << 32) | a;
+        };
+        std::vector<std::uint64_t> segments(output->numberofsegments);
+        for (size_t i = 0; i < segments.size(); i++) {
+            segments[i] = edge_key(segment_ptr[i * 2], segment_ptr[i * 2 + 1]);
+        }
+        TriangleManipulator::parallel_sort(segments.begin(), segments.end());
+
         std::shared_ptr<std::vector<double>> new_holes = std::shared_ptr<std::vector<double>>(new std::vector<double>());
-        std::shared_ptr<triangulateio> triangle_vobject = TriangleManipulator::create_instance();
-        std::shared_ptr<triangulateio> _output = TriangleManipulator::create_instance();
-        double* holeptr = triangle_object->holelist.get();
-        int starting_holes = triangle_object->numberofholes;
-        for (size_t i = 0; i < triangle_object->numberofholes; i++) {
-            holes->push_back(holeptr[i * 2]);
-            holes->push_back(holeptr[i * 2 + 1]);
-        }
-        triangulate("pvzXEQD", input, _output, triangle_vobject);
-        int iteration = 0;
-        do {
-            if (triangle_vobject->numberofpoints < 1) {
-                break;
-            }
-            
-            iteration++;
-            double x = triangle_vobject->pointlist.get()[0];
-            double y = triangle_vobject->pointlist.get()[1];
-            holes->reserve(holes->size() + 2);
-            new_holes->reserve(new_holes->size() + 2);
-            holes->push_back(x);
-            holes->push_back(y);
-            new_holes->push_back(x);
-            new_holes->push_back(y);
-            input = _output;
-            input->numberofholes = iteration + starting_holes;
-            input->holelist = std::shared_ptr<double[]>(holes->data(), [](void*) {});
-            triangulate("pvzXEQD", input, _output, triangle_vobject);
-            TriangleManipulator::write_poly_file("Maps/abtesting.object.1." + std::to_string(iteration) + ".poly", input);
-        } while(triangle_vobject->numberofpoints != 0);
+        std::vector<bool> visited(num_triangles, false);
+        std::vector<unsigned int> stack;
+        for (size_t seed = 0; seed < num_triangles; seed++) {
+            if (visited[seed]) {
+                continue;
+            }
+            // Flood the region this triangle is in, never crossing a segment, and keep its largest triangle's centroid.
+            visited[seed] = true;
+            stack.push_back(seed);
+            double best_area = -1;
+            double best_x = 0, best_y = 0;
+            while (!stack.empty()) {
+                const unsigned int triangle = stack.back();
+                stack.pop_back();
+                const unsigned int* corners = triangle_ptr + triangle * 3;
+                const REAL* a = point_ptr + corners[0] * 2;
+                const REAL* b = point_ptr + corners[1] * 2;
+                const REAL* c = point_ptr + corners[2] * 2;
+                const double area = std::abs((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]));
+                if (area > best_area) {
+                    best_area = area;
+                    best_x = (a[0] + b[0] + c[0]) / 3;
+                    best_y = (a[1] + b[1] + c[1]) / 3;
+                }
+                for (size_t side = 0; side < 3; side++) {
+                    // Neighbor side is opposite corner side.
+                    const int neighbor = neighbor_ptr[triangle * 3 + side];
+                    if (neighbor < 0 || visited[neighbor]) {
+                        continue;
+                    }
+                    if (std::binary_search(segments.begin(), segments.end(), edge_key(corners[(side + 1) % 3], corners[(side + 2) % 3]))) {
+                        continue;
+                    }
+                    visited[neighbor] = true;
+                    stack.push_back(neighbor);
+                }
+            }
+            new_holes->push_back(best_x);
+            new_holes->push_back(best_y);
+        }
         return new_holes;
     }
-    void from_list(const std::vector<PointLocation::Line>& list, std::shared_ptr<triangulateio> output) {
-        std::unordered_map<unsigned int, unsigned short> points = std::unordered_map<unsigned int, unsigned short>();
-        output->numberofsegments = list.size();
-        output->segmentlist = trimalloc<int>(output->numberofsegments * 2);
-        output->segmentmarkerlist = trimalloc<int>(output->numberofsegments);
-        int point_count = 0;
-        std::unordered_set<int> points_set = std::unordered_set<int>();
-        points_set.reserve(list.size() * 2);
-        for(const PointLocation::Line& line : list) {
-            points_set.insert(line.first.hash).second && point_count++;
-            points_set.insert(line.second.hash).second && point_count++;
-        }
-        points_set.clear();
-        output->numberofpoints = point_count;
-        output->pointlist = trimalloc<REAL>(point_count * 2);
-        output->pointmarkerlist = trimalloc<int>(point_count);
-        unsigned short point_index = 0;
-        int segment_index = 0;
-        REAL* output_point_ptr = output->pointlist.get();
-        int* output_point_marker_ptr = output->pointmarkerlist.get();
-        int* output_segment_ptr = output->segmentlist.get();
-        int* output_segment_marker_ptr = output->segmentmarkerlist.get();
-        std::memset(output_point_marker_ptr, 1, sizeof(int) * point_count);
-        std::memset(output_segment_marker_ptr, 1, sizeof(int) * point_count);
-        for (const PointLocation::Line& line : list) {
-            const PointLocation::Point& first = line.first;
-            const PointLocation::Point& second = line.second;
-            std::unordered_map<unsigned int, unsigned short>::iterator first_find = points.find(first.hash);
-            if(first_find == points.end()) {
-                output_point_ptr[point_index * 2] = first.x;
-                output_point_ptr[point_index * 2 + 1] = first.y;
-                first_find = points.emplace(first.hash, point_index++).first;
-            }
-            std::unordered_map<unsigned int, unsigned short>::iterator second_find = points.find(second.hash);
-            if(second_find == points.end()) {
-                output_point_ptr[point_index * 2] = second.x;
-                output_point_ptr[point_index * 2 + 1] = second.y;
-                second_find = points.emplace(second.hash, point_index++).first;
-            }
-            output_segment_ptr[segment_index * 2] = first_find->second;
-            output_segment_ptr[segment_index * 2 + 1] = second_find->second;
-            segment_index++;
+    namespace {
+        constexpr size_t FROM_LIST_CHUNK = 1 << 14;
+
+        /**
+         * @brief Call func(line, segment_index) for every line in [begin, end) of the concatenated lists. offsets[i] is where list i starts.
+         */
+        template<typename Func>
+        inline void for_each_line(const std::vector<std::span<const PointLocation::Line>>& lists, const std::vector<size_t>& offsets, size_t begin, size_t end, Func&& func) {
+            size_t list = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+            for (size_t index = begin; index < end; list++) {
+                const std::span<const PointLocation::Line> lines = lists[list];
+                for (size_t line = index - offsets[list], last = std::min(lines.size(), end - offsets[list]); line < last; line++, index++) {
+                    func(lines[line], index);
+                }
+            }
+        }
+
+        /**
+         * @brief Shared by both from_list overloads. Points are deduplicated by sorting their packed hashes, so a point's id is its rank.
+         */
+        void from_lists(const std::vector<std::span<const PointLocation::Line>>& lists, std::shared_ptr<triangulateio> output) {
+            std::vector<size_t> offsets;
+            offsets.reserve(lists.size());
+            size_t num_segments = 0;
+            for (const std::span<const PointLocation::Line>& lines : lists) {
+                offsets.push_back(num_segments);
+                num_segments += lines.size();
+            }
+            std::vector<unsigned int> hashes(num_segments * 2);
+            TriangleManipulator::parallel_chunks(num_segments, FROM_LIST_CHUNK, [&](size_t, size_t begin, size_t end) {
+                for_each_line(lists, offsets, begin, end, [&](const PointLocation::Line& line, size_t index) {
+                    hashes[index * 2] = line.first.hash;
+                    hashes[index * 2 + 1] = line.second.hash;
+                });
+            });
+            TriangleManipulator::parallel_sort(hashes.begin(), hashes.end());
+            hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+            const size_t num_points = hashes.size();
+
+            output->numberofpoints = num_points;
+            output->pointlist = TriangleManipulator::allocate<REAL>(num_points * 2);
+            output->pointmarkerlist = TriangleManipulator::allocate<int>(num_points);
+            output->numberofsegments = num_segments;
+            output->segmentlist = TriangleManipulator::allocate<int>(num_segments * 2);
+            output->segmentmarkerlist = TriangleManipulator::allocate<int>(num_segments);
+            REAL* output_point_ptr = output->pointlist.get();
+            int* output_segment_ptr = output->segmentlist.get();
+            std::fill_n(output->pointmarkerlist.get(), num_points, 1);
+            std::fill_n(output->segmentmarkerlist.get(), num_segments, 1);
+            TriangleManipulator::parallel_for(num_points, FROM_LIST_CHUNK, [&](size_t i) {
+                PointLocation::Point point;
+                point.hash = hashes[i];
+                output_point_ptr[i * 2] = point.x;
+                output_point_ptr[i * 2 + 1] = point.y;
+            });
+            TriangleManipulator::parallel_chunks(num_segments, FROM_LIST_CHUNK, [&](size_t, size_t begin, size_t end) {
+                const auto id = [&hashes](const PointLocation::Point& point) {
+                    return static_cast<int>(std::lower_bound(hashes.begin(), hashes.end(), point.hash) - hashes.begin());
+                };
+                for_each_line(lists, offsets, begin, end, [&](const PointLocation::Line& line, size_t index) {
+                    output_segment_ptr[index * 2] = id(line.first);
+                    output_segment_ptr[index * 2 + 1] = id(line.second);
+                });
+            });
         }
     }
+    namespace {
+        /**
+         * @brief A line as an interval along its supporting line. Lattice points on a line with reduced direction (dx, dy) are exactly
+         * (dx, dy) apart, so x * dx + y * dy orders them and collinear lines can be merged without any rounding.
+         */
+        struct CollinearInterval {
+            long dx;
+            long dy;
+            long offset;
+            long begin;
+            long end;
+            PointLocation::Point first;
+            PointLocation::Point second;
+            constexpr bool operator<(const CollinearInterval& rhs) const {
+                return std::tie(dx, dy, offset, begin) < std::tie(rhs.dx, rhs.dy, rhs.offset, rhs.begin);
+            }
+            constexpr bool same_line(const CollinearInterval& rhs) const {
+                return dx == rhs.dx && dy == rhs.dy && offset == rhs.offset;
+            }
+        };
+
+        size_t point_count(const std::vector<PointLocation::Line>& lines) {
+            std::vector<unsigned int> hashes;
+            hashes.reserve(lines.size() * 2);
+            for (const PointLocation::Line& line : lines) {
+                hashes.push_back(line.first.hash);
+                hashes.push_back(line.second.hash);
+            }
+            TriangleManipulator::parallel_sort(hashes.begin(), hashes.end());
+            return std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+        }
+
+        size_t triangle_count(const std::vector<PointLocation::Line>& lines) {
+            std::shared_ptr<triangulateio> input = TriangleManipulator::create_instance();
+            std::shared_ptr<triangulateio> output = TriangleManipulator::create_instance();
+            std::shared_ptr<triangulateio> vorout = TriangleManipulator::create_instance();
+            from_list(lines, input);
+            triangulate("pzQ", input, output, vorout);
+            return output->numberoftriangles;
+        }
+    }
+    SimplifyReport simplify_lines(std::vector<PointLocation::Line>& lines, bool count_triangles) {
+        SimplifyReport report = { point_count(lines), 0, lines.size(), 0, std::nullopt, std::nullopt };
+        if (count_triangles) {
+            report.triangles_before = triangle_count(lines);
+        }
+        std::vector<CollinearInterval> intervals;
+        intervals.reserve(lines.size());
+        for (const PointLocation::Line& line : lines) {
+            long dx = line.x2 - line.x1, dy = line.y2 - line.y1;
+            if (dx == 0 && dy == 0) {
+                continue;
+            }
+            const long divisor = std::gcd(dx, dy);
+            dx /= divisor;
+            dy /= divisor;
+            PointLocation::Point first = line.first, second = line.second;
+            if (dx < 0 || (dx == 0 && dy < 0)) {
+                dx = -dx;
+                dy = -dy;
+                std::swap(first, second);
+            }
+            intervals.push_back({ dx, dy, dy * first.x - dx * first.y, first.x * dx + first.y * dy, second.x * dx + second.y * dy, first, second });
+        }
+        TriangleManipulator::parallel_sort(intervals.begin(), intervals.end());
+        // End points shared with a line in another direction are T junctions. Triangle would put the vertex back, so runs aren't joined there.
+        std::vector<std::pair<unsigned int, size_t>> ends;
+        ends.reserve(intervals.size() * 2);
+        for (size_t i = 0, group = 0; i < intervals.size(); i++) {
+            group += i > 0 && !intervals[i].same_line(intervals[i - 1]);
+            ends.emplace_back(intervals[i].first.hash, group);
+            ends.emplace_back(intervals[i].second.hash, group);
+        }
+        TriangleManipulator::parallel_sort(ends.begin(), ends.end());
+        std::vector<unsigned int> junctions;
+        for (size_t i = 1; i < ends.size(); i++) {
+            if (ends[i].first == ends[i - 1].first && ends[i].second != ends[i - 1].second && (junctions.empty() || junctions.back() != ends[i].first)) {
+                junctions.push_back(ends[i].first);
+            }
+        }
+        const auto joins_at_junction = [&junctions](const CollinearInterval& merged, const CollinearInterval& next) {
+            return next.begin == merged.end && std::binary_search(junctions.begin(), junctions.end(), next.first.hash);
+        };
+        lines.clear();
+        for (size_t i = 0; i < intervals.size();) {
+            CollinearInterval merged = intervals[i];
+            for (i++; i < intervals.size() && merged.same_line(intervals[i]) && intervals[i].begin <= merged.end && !joins_at_junction(merged, intervals[i]); i++) {
+                if (intervals[i].end > merged.end) {
+                    merged.end = intervals[i].end;
+                    merged.second = intervals[i].second;
+                }
+            }
+            lines.emplace_back(merged.first, merged.second);
+        }
+        report.points_after = point_count(lines);
+        report.segments_after = lines.size();
+        if (count_triangles) {
+            report.triangles_after = triangle_count(lines);
+        }
+        return report;
+    }
+    void from_list(const std::vector<PointLocation::Line>& list, std::shared_ptr<triangulateio> output) {
+        from_lists({ std::span<const PointLocation::Line>(list) }, output);
+    }
     void from_list(const std::vector<std::shared_ptr<std::vector<PointLocation::Line>>>& list_of_lists, std::shared_ptr<triangulateio> output) {
-        std::unordered_map<unsigned int, unsigned short> points = std::unordered_map<unsigned int, unsigned short>();
-        int num_segments = 0;
-        for(const std::shared_ptr<std::vector<PointLocation::Line>>& list : list_of_lists) {
-            num_segments += list->size();
-        }
-        output->numberofsegments = num_segments;
-        output->segmentlist = trimalloc<int>(num_segments * 2);
-        output->segmentmarkerlist = trimalloc<int>(num_segments);
-
-        int point_count = 0;
-        std::unordered_set<unsigned int> points_set = std::unordered_set<unsigned int>();
-        
-        for(const std::shared_ptr<std::vector<PointLocation::Line>>& list : list_of_lists) {
-            for(const PointLocation::Line& line : *list) {
-                points_set.insert(line.first.hash).second && point_count++;
-                points_set.insert(line.second.hash).second && point_count++;
-            }
-        }
-        points_set.clear();
-        output->numberofpoints = point_count;
-        output->pointlist = trimalloc<REAL>(point_count * 2);
-        output->pointmarkerlist = trimalloc<int>(point_count);
-        unsigned short point_index = 0;
-        int segment_index = 0;
-        REAL* output_point_ptr = output->pointlist.get();
-        int* output_point_marker_ptr = output->pointmarkerlist.get();
-        int* output_segment_ptr = output->segmentlist.get();
-        int* output_segment_marker_ptr = output->segmentmarkerlist.get();
-        for(const std::shared_ptr<std::vector<PointLocation::Line>>& list : list_of_lists) {
-            for(const PointLocation::Line& line : *list) {
-                const PointLocation::Point& first = line.first;
-                const PointLocation::Point& second = line.second;
-                std::unordered_map<unsigned int, unsigned short>::iterator first_find = points.find(first.hash);
-                if(first_find == points.end()) {
-                    output_point_ptr[point_index * 2] = first.x;
-                    output_point_ptr[point_index * 2 + 1] = first.y;
-                    output_point_marker_ptr[point_index] = 1;
-                    first_find = points.emplace(first.hash, point_index++).first;
-                }
-                std::unordered_map<unsigned int, unsigned short>::iterator second_find = points.find(second.hash);
-                if(second_find == points.end()) {
-                    output_point_ptr[point_index * 2] = second.x;
-                    output_point_ptr[point_index * 2 + 1] = second.y;
-                    output_point_marker_ptr[point_index] = 1;
-                    second_find = points.emplace(second.hash, point_index++).first;
-                }
-                output_segment_ptr[segment_index * 2] = first_find->second;
-                output_segment_ptr[segment_index * 2 + 1] = second_find->second;
-                output_segment_marker_ptr[segment_index] = 1;
-                segment_index++;
+        std::vector<std::span<const PointLocation::Line>> lists;
+        lists.reserve(list_of_lists.size());
+        for (const std::shared_ptr<std::vector<PointLocation::Line>>& list : list_of_lists) {
+            lists.emplace_back(*list);
+        }
+        from_lists(lists, output);
+    }
+}
+namespace ShapeManipulator {
+    namespace {
+        typedef __int128 wide_t;
+
+        /**
+         * @brief An exact point, (x / d, y / d) with d > 0. Segment end points have d = 1; intersections of short coordinates fit comfortably.
+         */
+        struct RationalPoint {
+            long x;
+            long y;
+            long d;
+            constexpr bool operator<(const RationalPoint& rhs) const {
+                const wide_t lx = (wide_t) x * rhs.d, rx = (wide_t) rhs.x * d;
+                if (lx != rx) {
+                    return lx < rx;
+                }
+                return (wide_t) y * rhs.d < (wide_t) rhs.y * d;
+            }
+            constexpr bool operator==(const RationalPoint& rhs) const {
+                return (wide_t) x * rhs.d == (wide_t) rhs.x * d && (wide_t) y * rhs.d == (wide_t) rhs.y * d;
+            }
+        };
+
+        /**
+         * @brief A segment oriented left to right (bottom to top if vertical).
+         */
+        struct SweepSegment {
+            long x1;
+            long y1;
+            long x2;
+            long y2;
+            inline RationalPoint left() const {
+                return { x1, y1, 1 };
+            }
+            inline RationalPoint right() const {
+                return { x2, y2, 1 };
+            }
+            inline bool vertical() const {
+                return x1 == x2;
+            }
+        };
+
+        struct SweepState {
+            std::vector<SweepSegment> segments;
+            RationalPoint sweep;
+        };
+
+        struct Fraction {
+            wide_t numerator;
+            wide_t denominator;
+        };
+
+        inline int compare(const Fraction& a, const Fraction& b) {
+            const wide_t left = a.numerator * b.denominator;
+            const wide_t right = b.numerator * a.denominator;
+            return (left > right) - (left < right);
+        }
+
+        /**
+         * @brief Where a segment crosses the sweep line. Verticals are only in the status while the sweep is on them, and sit at the sweep point.
+         */
+        inline Fraction y_at_sweep(const SweepSegment& segment, const RationalPoint& sweep) {
+            if (segment.vertical()) {
+                return { sweep.y, sweep.d };
+            }
+            const long dx = segment.x2 - segment.x1;
+            const long dy = segment.y2 - segment.y1;
+            return { (wide_t) segment.y1 * dx * sweep.d + ((wide_t) sweep.x - (wide_t) segment.x1 * sweep.d) * dy, (wide_t) dx * sweep.d };
+        }
+
+        /**
+         * @brief Orders the status by height at the sweep point; segments through the sweep point by slope, i.e. by height just after it.
+         */
+        struct StatusCompare {
+            using is_transparent = void;
+            const SweepState* state;
+            inline bool operator()(std::uint32_t a, std::uint32_t b) const {
+                const SweepSegment& first = state->segments[a];
+                const SweepSegment& second = state->segments[b];
+                const int height = compare(y_at_sweep(first, state->sweep), y_at_sweep(second, state->sweep));
+                if (height != 0) {
+                    return height < 0;
+                }
+                if (first.vertical() != second.vertical()) {
+                    return second.vertical();
+                }
+                if (!first.vertical()) {
+                    const wide_t slope_first = (wide_t) (first.y2 - first.y1) * (second.x2 - second.x1);
+                    const wide_t slope_second = (wide_t) (second.y2 - second.y1) * (first.x2 - first.x1);
+                    if (slope_first != slope_second) {
+                        return slope_first < slope_second;
+                    }
+                }
+                return a < b;
+            }
+            inline bool operator()(std::uint32_t a, const RationalPoint& point) const {
+                return compare(y_at_sweep(state->segments[a], state->sweep), { point.y, point.d }) < 0;
+            }
+            inline bool operator()(const RationalPoint& point, std::uint32_t b) const {
+                return compare({ point.y, point.d }, y_at_sweep(state->segments[b], state->sweep)) < 0;
+            }
+        };
+
+        /**
+         * @brief The single point two segments meet at, if there is one. Collinear overlaps have no single point and are left to the end point events.
+         */
+        inline std::optional<RationalPoint> intersection(const SweepSegment& first, const SweepSegment& second) {
+            const long rx = first.x2 - first.x1, ry = first.y2 - first.y1;
+            const long sx = second.x2 - second.x1, sy = second.y2 - second.y1;
+            long denominator = rx * sy - ry * sx;
+            if (denominator == 0) {
+                return std::nullopt;
+            }
+            const long qx = second.x1 - first.x1, qy = second.y1 - first.y1;
+            long t = qx * sy - qy * sx;
+            long u = qx * ry - qy * rx;
+            if (denominator < 0) {
+                denominator = -denominator;
+                t = -t;
+                u = -u;
+            }
+            if (t < 0 || t > denominator || u < 0 || u > denominator) {
+                return std::nullopt;
+            }
+            return RationalPoint{ first.x1 * denominator + t * rx, first.y1 * denominator + t * ry, denominator };
+        }
+    }
+
+    std::vector<SegmentIntersection> find_intersections(const std::vector<PointLocation::Line>& lines) {
+        SweepState state;
+        state.segments.reserve(lines.size());
+        std::map<RationalPoint, std::vector<std::uint32_t>> events;
+        for (std::uint32_t i = 0, size = lines.size(); i < size; i++) {
+            const PointLocation::Line& line = lines[i];
+            SweepSegment segment = { line.x1, line.y1, line.x2, line.y2 };
+            if (segment.right() < segment.left()) {
+                segment = { line.x2, line.y2, line.x1, line.y1 };
+            }
+            state.segments.push_back(segment);
+            // Left end points carry the segments that start there; right end points just need to exist as events.
+            events[segment.left()].push_back(i);
+            events.try_emplace(segment.right());
+        }
+        std::set<std::uint32_t, StatusCompare> status(StatusCompare{ &state });
+        std::vector<SegmentIntersection> result;
+        std::vector<std::uint32_t> involved;
+        std::vector<std::uint32_t> continuing;
+
+        const auto schedule = [&](std::uint32_t below, std::uint32_t above) {
+            const std::optional<RationalPoint> point = intersection(state.segments[below], state.segments[above]);
+            if (point && state.sweep < *point) {
+                events.try_emplace(*point);
+            }
+        };
+
+        while (!events.empty()) {
+            const auto event = events.begin();
+            const RationalPoint point = event->first;
+            const std::vector<std::uint32_t> starting = std::move(event->second);
+            events.erase(event);
+            state.sweep = point;
+
+            involved.assign(starting.begin(), starting.end());
+            continuing.clear();
+            auto [first, last] = status.equal_range(point);
+            for (auto current = first; current != last; current++) {
+                involved.push_back(*current);
+                if (!(state.segments[*current].right() == point)) {
+                    continuing.push_back(*current);
+                }
+            }
+            if (involved.size() > 1) {
+                const double x = (double) point.x / point.d;
+                const double y = (double) point.y / point.d;
+                for (size_t i = 0; i < involved.size(); i++) {
+                    for (size_t j = i + 1; j < involved.size(); j++) {
+                        result.push_back({ std::min(involved[i], involved[j]), std::max(involved[i], involved[j]), x, y });
+                    }
+                }
+            }
+            // Erasing by iterator never compares, so it's fine that segments crossing here are now out of order.
+            status.erase(first, last);
+            for (const std::uint32_t segment : starting) {
+                if (!(state.segments[segment].right() == point)) {
+                    continuing.push_back(segment);
+                }
+            }
+            for (const std::uint32_t segment : continuing) {
+                status.insert(segment);
+            }
+            if (continuing.empty()) {
+                const auto above = status.lower_bound(point);
+                if (above != status.end() && above != status.begin()) {
+                    schedule(*std::prev(above), *above);
+                }
+                continue;
+            }
+            auto [lowest, past_highest] = status.equal_range(point);
+            if (lowest != status.begin()) {
+                schedule(*std::prev(lowest), *lowest);
+            }
+            if (past_highest != status.end()) {
+                schedule(*std::prev(past_highest), *past_highest);
+            }
+        }
+        return result;
+    }
+
+    namespace {
+        constexpr int SPLIT_PASS_LIMIT = 64;
+
+        /**
+         * @brief One splitting pass, which also drops duplicate and zero length lines. Returns whether anything was split.
+         */
+        bool split_pass(const std::vector<PointLocation::Line>& lines, std::vector<PointLocation::Line>& result) {
+            std::vector<std::vector<PointLocation::Point>> splits(lines.size());
+            bool split = false;
+            for (const SegmentIntersection& found : find_intersections(lines)) {
+                const PointLocation::Point point = { (short) std::lround(found.x), (short) std::lround(found.y) };
+                for (const std::uint32_t line : { found.first, found.second }) {
+                    if (!(lines[line].first == point) && !(lines[line].second == point)) {
+                        splits[line].push_back(point);
+                        split = true;
+                    }
+                }
+            }
+            result.clear();
+            result.reserve(lines.size() * 2);
+            std::unordered_set<PointLocation::Line::hash_t> seen;
+            seen.reserve(lines.size() * 2);
+            const auto emit = [&](PointLocation::Point a, PointLocation::Point b) {
+                if (a == b) {
+                    return;
+                }
+                if (b.x < a.x || (b.x == a.x && b.y < a.y)) {
+                    std::swap(a, b);
+                }
+                const PointLocation::Line line = PointLocation::Line(a, b);
+                if (seen.insert(line.hash).second) {
+                    result.push_back(line);
+                }
+            };
+            for (size_t i = 0; i < lines.size(); i++) {
+                const PointLocation::Line& line = lines[i];
+                std::vector<PointLocation::Point>& points = splits[i];
+                points.push_back(line.first);
+                points.push_back(line.second);
+                const long dx = line.x2 - line.x1, dy = line.y2 - line.y1;
+                std::sort(points.begin(), points.end(), [&](const PointLocation::Point& a, const PointLocation::Point& b) {
+                    return (long) (a.x - line.x1) * dx + (long) (a.y - line.y1) * dy < (long) (b.x - line.x1) * dx + (long) (b.y - line.y1) * dy;
+                });
+                for (size_t j = 1; j < points.size(); j++) {
+                    emit(points[j - 1], points[j]);
+                }
+            }
+            return split;
+        }
+    }
+
+    std::vector<PointLocation::Line> split_intersections(const std::vector<PointLocation::Line>& lines) {
+        std::vector<PointLocation::Line> current = lines;
+        std::vector<PointLocation::Line> next;
+        // Rounding a crossing onto the grid can nudge a piece across a neighbour; another pass splits those. Real outlines settle in two or
+        // three passes, so running into the cap means the rounding is going in circles, and the caller must not get lines that still cross.
+        for (int pass = 0; pass < SPLIT_PASS_LIMIT; pass++) {
+            const bool split = split_pass(current, next);
+            std::swap(current, next);
+            if (!split) {
+                return current;
             }
         }
+        throw std::runtime_error(fmt::format("Lines still cross after {} splitting passes", SPLIT_PASS_LIMIT));
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,153 @@
+#include "TriangleManipulator/SpatialOrder.hpp"
+#include "TriangleManipulator/TriangleManipulator.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+namespace TriangleManipulator {
+    namespace {
+        // Spread the low 32 bits of v out to the even bits.
+        inline std::uint64_t spread_bits(std::uint64_t v) {
+            v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+            v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+            v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+            v = (v | (v << 2)) & 0x3333333333333333ull;
+            v = (v | (v << 1)) & 0x5555555555555555ull;
+            return v;
+        }
+
+        // Second order meshes (the o2 switch) have 6. Meshes filled in by hand may leave it at 0.
+        inline size_t corner_count(const triangulateio& mesh) {
+            return mesh.numberofcorners > 0 ? mesh.numberofcorners : 3;
+        }
+
+        template<typename T>
+        inline void remap_indices(const T* from, T* to, size_t count, std::span<const unsigned int> point_map) {
+            parallel_chunks(count, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    // Voronoi edges use -1 for the missing end of a ray.
+                    if constexpr (std::is_signed_v<T>) {
+                        to[i] = from[i] < 0 ? from[i] : T(point_map[from[i]]);
+                    } else {
+                        to[i] = point_map[from[i]];
+                    }
+                }
+            });
+        }
+    }
+
+    std::uint64_t curve_key(std::uint32_t x, std::uint32_t y, space_filling_curve curve) {
+        if (curve == space_filling_curve::morton) {
+            return spread_bits(x) | (spread_bits(y) << 1);
+        }
+        std::uint64_t key = 0;
+        for (std::uint32_t s = 1u << 31; s > 0; s >>= 1) {
+            const std::uint32_t rx = (x & s) != 0;
+            const std::uint32_t ry = (y & s) != 0;
+            key += std::uint64_t(s) * s * ((3 * rx) ^ ry);
+            // Rotate the quadrant so the curve inside it starts and ends where its neighbours' do.
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = ~x;
+                    y = ~y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return key;
+    }
+
+    std::vector<unsigned int> spatial_order(const REAL* points, size_t count, space_filling_curve curve) {
+        double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (size_t i = 0; i < count; i++) {
+            min_x = std::min(min_x, points[i * 2]);
+            max_x = std::max(max_x, points[i * 2]);
+            min_y = std::min(min_y, points[i * 2 + 1]);
+            max_y = std::max(max_y, points[i * 2 + 1]);
+        }
+        // One scale for both axes, so the cells stay square.
+        const double extent = std::max(max_x - min_x, max_y - min_y);
+        const double scale = extent > 0 ? 4294967295.0 / extent : 0;
+        std::vector<std::pair<std::uint64_t, unsigned int>> keys(count);
+        parallel_chunks(count, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const std::uint32_t x = static_cast<std::uint32_t>((points[i * 2] - min_x) * scale);
+                const std::uint32_t y = static_cast<std::uint32_t>((points[i * 2 + 1] - min_y) * scale);
+                keys[i] = { curve_key(x, y, curve), static_cast<unsigned int>(i) };
+            }
+        });
+        parallel_sort(keys.begin(), keys.end());
+        std::vector<unsigned int> order(count);
+        for (size_t i = 0; i < count; i++) {
+            order[i] = keys[i].second;
+        }
+        return order;
+    }
+
+    std::vector<unsigned int> reorder_points(std::shared_ptr<const triangulateio> input, std::shared_ptr<triangulateio> output, space_filling_curve curve) {
+        // Holding the input's arrays lets output be input.
+        const triangulateio source = *input;
+        const size_t points = source.numberofpoints;
+        const size_t attributes = source.numberofpointattributes;
+        const std::vector<unsigned int> order = spatial_order(source.pointlist.get(), points, curve);
+        std::vector<unsigned int> point_map(points);
+        for (size_t i = 0; i < points; i++) {
+            point_map[order[i]] = i;
+        }
+
+        // Only points move, so everything but the arrays rewritten below carries over as is.
+        *output = source;
+        const REAL* point_ptr = source.pointlist.get();
+        const REAL* attribute_ptr = source.pointattributelist.get();
+        const int* marker_ptr = source.pointmarkerlist.get();
+        output->pointlist = allocate<REAL>(points * 2);
+        output->pointattributelist = attribute_ptr ? allocate<REAL>(points * attributes) : nullptr;
+        output->pointmarkerlist = marker_ptr ? allocate<int>(points) : nullptr;
+        REAL* out_point_ptr = output->pointlist.get();
+        REAL* out_attribute_ptr = output->pointattributelist.get();
+        int* out_marker_ptr = output->pointmarkerlist.get();
+        parallel_chunks(points, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const size_t from = order[i];
+                out_point_ptr[i * 2] = point_ptr[from * 2];
+                out_point_ptr[i * 2 + 1] = point_ptr[from * 2 + 1];
+                if (attribute_ptr) {
+                    std::copy_n(attribute_ptr + from * attributes, attributes, out_attribute_ptr + i * attributes);
+                }
+                if (marker_ptr) {
+                    out_marker_ptr[i] = marker_ptr[from];
+                }
+            }
+        });
+
+        // Fresh arrays, so meshes sharing the input's index arrays aren't changed under them.
+        if (source.trianglelist) {
+            const size_t corners = size_t(source.numberoftriangles) * corner_count(source);
+            output->trianglelist = allocate<unsigned int>(corners);
+            remap_indices(source.trianglelist.get(), output->trianglelist.get(), corners, point_map);
+        }
+        if (source.segmentlist) {
+            output->segmentlist = allocate<int>(size_t(source.numberofsegments) * 2);
+            remap_indices(source.segmentlist.get(), output->segmentlist.get(), size_t(source.numberofsegments) * 2, point_map);
+        }
+        if (source.edgelist) {
+            output->edgelist = allocate<int>(size_t(source.numberofedges) * 2);
+            remap_indices(source.edgelist.get(), output->edgelist.get(), size_t(source.numberofedges) * 2, point_map);
+        }
+        return point_map;
+    }
+
+    void renumber_points(std::shared_ptr<triangulateio> mesh, std::span<const unsigned int> point_map) {
+        if (mesh->trianglelist) {
+            remap_indices(mesh->trianglelist.get(), mesh->trianglelist.get(), size_t(mesh->numberoftriangles) * corner_count(*mesh), point_map);
+        }
+        if (mesh->segmentlist) {
+            remap_indices(mesh->segmentlist.get(), mesh->segmentlist.get(), size_t(mesh->numberofsegments) * 2, point_map);
+        }
+        if (mesh->edgelist) {
+            remap_indices(mesh->edgelist.get(), mesh->edgelist.get(), size_t(mesh->numberofedges) * 2, point_map);
+        }
+    }
+}
@@ -0,0 +1,430 @@
+#include "TriangleManipulator/TiledLocator.hpp"
+#include "TriangleManipulator/ShapeManipulator.hpp"
+#include "TriangleManipulator/TriangleManipulator.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+
+namespace PointLocation {
+    namespace {
+        // Triangle keeps process wide state (exactinit's error bounds, its random seed), so only one tile triangulates at a time.
+        std::mutex triangulate_mutex;
+
+        /**
+         * @brief Where a line crosses x = boundary. Computed straight from the line, so both tiles sharing the boundary get the same point.
+         */
+        inline Point cross_vertical(const Line& line, int boundary) {
+            const long dx = line.x2 - line.x1, dy = line.y2 - line.y1;
+            return { (short) boundary, (short) std::lround(line.y1 + (double) ((boundary - line.x1) * dy) / dx) };
+        }
+
+        inline Point cross_horizontal(const Line& line, int boundary) {
+            const long dx = line.x2 - line.x1, dy = line.y2 - line.y1;
+            return { (short) std::lround(line.x1 + (double) ((boundary - line.y1) * dx) / dy), (short) boundary };
+        }
+
+        /**
+         * @brief Liang-Barsky clip of a line to a closed tile. Returns nothing if the line misses it.
+         * A line that only touches the border comes back as a single point, so the border is still split there like its neighbour's.
+         */
+        std::optional<Line> clip(const Line& line, const Tile& tile) {
+            const double dx = line.x2 - line.x1, dy = line.y2 - line.y1;
+            double t_min = 0, t_max = 1;
+            Point first = line.first, second = line.second;
+            const auto edge = [&](double p, double q, auto&& crossing) {
+                if (p == 0) {
+                    return q >= 0;
+                }
+                const double t = q / p;
+                if (p < 0) {
+                    if (t > t_max) {
+                        return false;
+                    }
+                    if (t > t_min) {
+                        t_min = t;
+                        first = crossing();
+                    }
+                } else {
+                    if (t < t_min) {
+                        return false;
+                    }
+                    if (t < t_max) {
+                        t_max = t;
+                        second = crossing();
+                    }
+                }
+                return true;
+            };
+            const bool inside = edge(-dx, line.x1 - tile.x0, [&]() { return cross_vertical(line, tile.x0); })
+                && edge(dx, tile.x1 - line.x1, [&]() { return cross_vertical(line, tile.x1); })
+                && edge(-dy, line.y1 - tile.y0, [&]() { return cross_horizontal(line, tile.y0); })
+                && edge(dy, tile.y1 - line.y1, [&]() { return cross_horizontal(line, tile.y1); });
+            if (!inside) {
+                return std::nullopt;
+            }
+            return Line(first, second);
+        }
+
+        /**
+         * @brief Whether a line lies along one of the tile's sides.
+         */
+        inline bool on_border(const Line& line, const Tile& tile) {
+            return (line.x1 == line.x2 && (line.x1 == tile.x0 || line.x1 == tile.x1)) || (line.y1 == line.y2 && (line.y1 == tile.y0 || line.y1 == tile.y1));
+        }
+
+        /**
+         * @brief Whether a piece of a tile's constraints is only its border, and not part of one of the lines along it in border_lines.
+         */
+        bool border_only(const Line& piece, const Tile& tile, const std::vector<Line>& border_lines) {
+            if (!on_border(piece, tile)) {
+                return false;
+            }
+            return std::none_of(border_lines.begin(), border_lines.end(), [&piece](const Line& line) {
+                if (piece.x1 == piece.x2) {
+                    return line.x1 == piece.x1 && line.x2 == piece.x1
+                        && std::min(line.y1, line.y2) <= std::min(piece.y1, piece.y2) && std::max(line.y1, line.y2) >= std::max(piece.y1, piece.y2);
+                }
+                return line.y1 == piece.y1 && line.y2 == piece.y1
+                    && std::min(line.x1, line.x2) <= std::min(piece.x1, piece.x2) && std::max(line.x1, line.x2) >= std::max(piece.x1, piece.x2);
+            });
+        }
+
+        /**
+         * @brief The lines clipped to a tile plus its border, split so they only meet at end points.
+         */
+        std::vector<Line> tile_constraints(const Tile& tile, std::vector<Line> lines) {
+            const short x0 = tile.x0, y0 = tile.y0, x1 = tile.x1, y1 = tile.y1;
+            lines.emplace_back(x0, y0, x1, y0);
+            lines.emplace_back(x1, y0, x1, y1);
+            lines.emplace_back(x1, y1, x0, y1);
+            lines.emplace_back(x0, y1, x0, y0);
+            return ShapeManipulator::split_intersections(lines);
+        }
+
+        /**
+         * @brief Triangulate lines inside a frame one unit outside [x0, x1] x [y0, y1], with attribute 1 on every triangle outside the lines
+         * or in a hole's region and 0 on the rest. Triangle spreads region attributes across non-segment edges just as p and holes eat
+         * triangles, so these are the areas a single mesh of the lines leaves out. A region point just inside the frame marks the outside.
+         */
+        std::shared_ptr<triangulateio> excluded_areas(const std::vector<Line>& lines, int x0, int y0, int x1, int y1, const std::vector<double>& holes) {
+            std::shared_ptr<triangulateio> input = TriangleManipulator::create_instance();
+            ShapeManipulator::from_list(lines, input);
+            // The frame can be past the range of short, so it's added after from_list.
+            const size_t points = input->numberofpoints, segments = input->numberofsegments;
+            const REAL frame[8] = { x0 - 1.0, y0 - 1.0, x1 + 1.0, y0 - 1.0, x1 + 1.0, y1 + 1.0, x0 - 1.0, y1 + 1.0 };
+            std::shared_ptr<REAL[]> point_list = TriangleManipulator::allocate<REAL>((points + 4) * 2);
+            std::copy_n(input->pointlist.get(), points * 2, point_list.get());
+            std::copy_n(frame, 8, point_list.get() + points * 2);
+            std::shared_ptr<int[]> segment_list = TriangleManipulator::allocate<int>((segments + 4) * 2);
+            int* segment_ptr = segment_list.get();
+            std::copy_n(input->segmentlist.get(), segments * 2, segment_ptr);
+            for (size_t i = 0; i < 4; i++) {
+                segment_ptr[(segments + i) * 2] = points + i;
+                segment_ptr[(segments + i) * 2 + 1] = points + (i + 1) % 4;
+            }
+            input->numberofpoints = points + 4;
+            input->pointlist = point_list;
+            input->pointmarkerlist = nullptr;
+            input->numberofsegments = segments + 4;
+            input->segmentlist = segment_list;
+            input->segmentmarkerlist = nullptr;
+
+            const size_t hole_count = holes.size() / 2;
+            input->numberofregions = hole_count + 1;
+            input->regionlist = TriangleManipulator::allocate<REAL>((hole_count + 1) * 4);
+            REAL* region_ptr = input->regionlist.get();
+            for (size_t i = 0; i <= hole_count; i++) {
+                region_ptr[i * 4] = i < hole_count ? holes[i * 2] : x0 - 0.5;
+                region_ptr[i * 4 + 1] = i < hole_count ? holes[i * 2 + 1] : y0 - 0.5;
+                region_ptr[i * 4 + 2] = 1;
+                region_ptr[i * 4 + 3] = 0;
+            }
+
+            std::shared_ptr<triangulateio> output = TriangleManipulator::create_instance();
+            std::shared_ptr<triangulateio> vorout = TriangleManipulator::create_instance();
+            const std::lock_guard<std::mutex> lock(triangulate_mutex);
+            triangulate("pzAQ", input, output, vorout);
+            return output;
+        }
+
+        /**
+         * @brief A point inside the part of a triangle that lies in a tile, or nothing if that part has no area.
+         */
+        std::optional<Vertex::Point> clipped_center(const std::array<Vertex::Point, 3>& corners, const Tile& tile) {
+            std::vector<Vertex::Point> polygon(corners.begin(), corners.end()), next;
+            // Sutherland-Hodgman against one side of the tile at a time.
+            const auto cut = [&](bool vertical, double bound, bool keep_above) {
+                const auto coordinate = [vertical](const Vertex::Point& point) {
+                    return vertical ? point.x : point.y;
+                };
+                const auto inside = [&](const Vertex::Point& point) {
+                    return keep_above ? coordinate(point) >= bound : coordinate(point) <= bound;
+                };
+                next.clear();
+                for (size_t i = 0; i < polygon.size(); i++) {
+                    const Vertex::Point& a = polygon[i];
+                    const Vertex::Point& b = polygon[(i + 1) % polygon.size()];
+                    if (inside(a)) {
+                        next.push_back(a);
+                    }
+                    if (inside(a) != inside(b)) {
+                        const double t = (bound - coordinate(a)) / (coordinate(b) - coordinate(a));
+                        next.push_back({ a.x + t * (b.x - a.x), a.y + t * (b.y - a.y) });
+                    }
+                }
+                polygon.swap(next);
+            };
+            cut(true, tile.x0, true);
+            cut(true, tile.x1, false);
+            cut(false, tile.y0, true);
+            cut(false, tile.y1, false);
+
+            double area = 0, x = 0, y = 0;
+            for (size_t i = 0; i < polygon.size(); i++) {
+                const Vertex::Point& a = polygon[i];
+                const Vertex::Point& b = polygon[(i + 1) % polygon.size()];
+                const double cross = a.x * b.y - b.x * a.y;
+                area += cross;
+                x += (a.x + b.x) * cross;
+                y += (a.y + b.y) * cross;
+            }
+            // Every region of a tile has lattice corners, so it's at least half a unit in area; slivers below this are just rounding.
+            if (std::abs(area) < 1e-9) {
+                return std::nullopt;
+            }
+            return Vertex::Point{ x / (3 * area), y / (3 * area) };
+        }
+
+        void build_tile(Tile& tile, const std::vector<Line>& constraints, const std::vector<double>& holes, const char* switches) {
+            tile.input = TriangleManipulator::create_instance();
+            ShapeManipulator::from_list(constraints, tile.input);
+            tile.input->numberofholes = holes.size() / 2;
+            tile.input->holelist = TriangleManipulator::allocate<REAL>(holes.size());
+            std::copy(holes.begin(), holes.end(), tile.input->holelist.get());
+
+            tile.mesh = TriangleManipulator::create_instance();
+            std::shared_ptr<triangulateio> vorout = TriangleManipulator::create_instance();
+            {
+                // GraphInfo's constructor triangulates too.
+                const std::lock_guard<std::mutex> lock(triangulate_mutex);
+                triangulate(switches, tile.input, tile.mesh, vorout);
+                tile.locator = GraphInfo(tile.input);
+            }
+            tile.locator.process();
+            tile.locator.map_triangles(tile.mesh);
+        }
+    }
+
+    TiledLocator::TiledLocator(const std::vector<Line>& lines, const TiledBuildOptions& options) : origin_x(0), origin_y(0), tile_size(options.tile_size), columns(0), rows(0), tile_list() {
+        if (tile_size <= 0) {
+            throw std::runtime_error(fmt::format("Tile size must be positive, got {}", tile_size));
+        }
+        // The locator is built over the input points only, so its triangles can't be matched to a mesh with extra vertices.
+        if (const char* steiner = std::strpbrk(options.switches, "qauDo")) {
+            throw std::runtime_error(fmt::format("Tile switches \"{}\" use '{}', which adds vertices the tile locators can't map", options.switches, *steiner));
+        }
+        if (lines.empty()) {
+            return;
+        }
+        int min_x = INT32_MAX, min_y = INT32_MAX, max_x = INT32_MIN, max_y = INT32_MIN;
+        for (const Line& line : lines) {
+            min_x = std::min({ min_x, (int) line.x1, (int) line.x2 });
+            min_y = std::min({ min_y, (int) line.y1, (int) line.y2 });
+            max_x = std::max({ max_x, (int) line.x1, (int) line.x2 });
+            max_y = std::max({ max_y, (int) line.y1, (int) line.y2 });
+        }
+        origin_x = min_x;
+        origin_y = min_y;
+        columns = std::max(1, (max_x - min_x + tile_size - 1) / tile_size);
+        rows = std::max(1, (max_y - min_y + tile_size - 1) / tile_size);
+        tile_list.resize(columns * rows);
+        for (std::uint32_t row = 0; row < rows; row++) {
+            for (std::uint32_t column = 0; column < columns; column++) {
+                Tile& tile = tile_list[row * columns + column];
+                tile.x0 = origin_x + column * tile_size;
+                tile.y0 = origin_y + row * tile_size;
+                // The last row and column stop at the map's edge, so the grid never leaves the range of short.
+                tile.x1 = std::max(std::min(tile.x0 + tile_size, max_x), tile.x0 + 1);
+                tile.y1 = std::max(std::min(tile.y0 + tile_size, max_y), tile.y0 + 1);
+            }
+        }
+
+        // Bin every line into the tiles its bounding box covers, clipped. Those along a tile's sides are kept apart too, to tell them from its border.
+        std::vector<std::vector<Line>> binned(tile_list.size());
+        std::vector<std::vector<Line>> border_lines(tile_list.size());
+        const auto column_of = [&](int x) {
+            return std::min<std::uint32_t>((x - origin_x) / tile_size, columns - 1);
+        };
+        const auto row_of = [&](int y) {
+            return std::min<std::uint32_t>((y - origin_y) / tile_size, rows - 1);
+        };
+        for (const Line& line : lines) {
+            // A line on a tile boundary belongs to the tiles on both sides.
+            const int low_x = std::min(line.x1, line.x2), high_x = std::max(line.x1, line.x2);
+            const int low_y = std::min(line.y1, line.y2), high_y = std::max(line.y1, line.y2);
+            const std::uint32_t first_column = column_of(low_x) - (column_of(low_x) > 0 && (low_x - origin_x) % tile_size == 0);
+            const std::uint32_t first_row = row_of(low_y) - (row_of(low_y) > 0 && (low_y - origin_y) % tile_size == 0);
+            for (std::uint32_t row = first_row, last_row = row_of(high_y); row <= last_row; row++) {
+                for (std::uint32_t column = first_column, last_column = column_of(high_x); column <= last_column; column++) {
+                    const std::uint32_t index = row * columns + column;
+                    if (const std::optional<Line> clipped = clip(line, tile_list[index])) {
+                        binned[index].push_back(*clipped);
+                        if (on_border(*clipped, tile_list[index])) {
+                            border_lines[index].push_back(*clipped);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Tiles vary a lot in cost, so workers claim them one at a time instead of taking fixed ranges.
+        // The first exception stops the others claiming more, and is rethrown here rather than ending the process on a worker thread.
+        const auto for_each_tile = [this](auto&& func) {
+            std::atomic<size_t> next = 0;
+            std::exception_ptr error;
+            std::mutex error_mutex;
+            TriangleManipulator::parallel_chunks(std::min<size_t>(tile_list.size(), TriangleManipulator::worker_count()), 1, [&](size_t, size_t, size_t) {
+                for (size_t index = next++; index < tile_list.size(); index = next++) {
+                    try {
+                        func(index);
+                    } catch (...) {
+                        const std::lock_guard<std::mutex> lock(error_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        next = tile_list.size();
+                    }
+                }
+            });
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        };
+        std::vector<std::vector<Line>> constraints(tile_list.size());
+        for_each_tile([&](size_t index) {
+            constraints[index] = tile_constraints(tile_list[index], std::move(binned[index]));
+        });
+
+        // Splitting rounds crossings onto the grid, which can land one on a border in only one of the two tiles sharing it.
+        // So neighbours swap the vertices on their shared border, and both split at all of them.
+        std::vector<std::vector<Line>> shared(tile_list.size());
+        const auto share = [&](size_t first, size_t second, auto&& on_border) {
+            for (const auto& [from, to] : { std::pair(first, second), std::pair(second, first) }) {
+                for (const Line& line : constraints[from]) {
+                    for (const Point& point : { line.first, line.second }) {
+                        if (on_border(point)) {
+                            shared[to].emplace_back(point, point);
+                        }
+                    }
+                }
+            }
+        };
+        for (std::uint32_t row = 0; row < rows; row++) {
+            for (std::uint32_t column = 0; column < columns; column++) {
+                const std::uint32_t index = row * columns + column;
+                const Tile& tile = tile_list[index];
+                if (column + 1 < columns) {
+                    share(index, index + 1, [&tile](const Point& point) {
+                        return point.x == tile.x1;
+                    });
+                }
+                if (row + 1 < rows) {
+                    share(index, index + columns, [&tile](const Point& point) {
+                        return point.y == tile.y1;
+                    });
+                }
+            }
+        }
+        for_each_tile([&](size_t index) {
+            // Everything already only meets at end points, and the new points are on the grid, so this split is exact.
+            std::vector<Line>& lines = constraints[index];
+            if (!shared[index].empty()) {
+                lines.insert(lines.end(), shared[index].begin(), shared[index].end());
+                lines = ShapeManipulator::split_intersections(lines);
+            }
+        });
+
+        // Holes and the outside have to be found over the whole map, or one crossing a tile border would stay meshed in the tiles it
+        // spills into. The tiles' own pieces are triangulated together without their borders, so the excluded triangles never cross a
+        // tile's constraints, and each piece a tile clips out of them lies in one of its regions.
+        std::vector<Line> pieces;
+        for (size_t index = 0; index < tile_list.size(); index++) {
+            for (const Line& piece : constraints[index]) {
+                if (piece.first.hash != piece.second.hash && !border_only(piece, tile_list[index], border_lines[index])) {
+                    pieces.push_back(piece);
+                }
+            }
+        }
+        const std::shared_ptr<triangulateio> excluded = excluded_areas(pieces, origin_x, origin_y, tile_list.back().x1, tile_list.back().y1, options.holes);
+        const unsigned int* triangle_ptr = excluded->trianglelist.get();
+        const REAL* point_ptr = excluded->pointlist.get();
+        const REAL* attribute_ptr = excluded->triangleattributelist.get();
+        const auto corners_of = [&](unsigned int triangle) {
+            std::array<Vertex::Point, 3> corners;
+            for (size_t i = 0; i < 3; i++) {
+                const unsigned int vertex = triangle_ptr[triangle * 3 + i];
+                corners[i] = { point_ptr[vertex * 2], point_ptr[vertex * 2 + 1] };
+            }
+            return corners;
+        };
+        const auto cell = [](double coordinate, int origin, int size, std::uint32_t count) {
+            return (std::uint32_t) std::clamp(std::floor((coordinate - origin) / size), 0.0, count - 1.0);
+        };
+        std::vector<std::vector<unsigned int>> excluded_triangles(tile_list.size());
+        for (unsigned int triangle = 0; attribute_ptr && triangle < (unsigned int) excluded->numberoftriangles; triangle++) {
+            if (attribute_ptr[triangle * excluded->numberoftriangleattributes] == 0) {
+                continue;
+            }
+            const std::array<Vertex::Point, 3> corners = corners_of(triangle);
+            const auto [low_x, high_x] = std::minmax({ corners[0].x, corners[1].x, corners[2].x });
+            const auto [low_y, high_y] = std::minmax({ corners[0].y, corners[1].y, corners[2].y });
+            for (std::uint32_t row = cell(low_y, origin_y, tile_size, rows), last_row = cell(high_y, origin_y, tile_size, rows); row <= last_row; row++) {
+                for (std::uint32_t column = cell(low_x, origin_x, tile_size, columns), last_column = cell(high_x, origin_x, tile_size, columns); column <= last_column; column++) {
+                    excluded_triangles[row * columns + column].push_back(triangle);
+                }
+            }
+        }
+
+        for_each_tile([&](size_t index) {
+            std::vector<double> holes;
+            for (unsigned int triangle : excluded_triangles[index]) {
+                if (const std::optional<Vertex::Point> seed = clipped_center(corners_of(triangle), tile_list[index])) {
+                    holes.push_back(seed->x);
+                    holes.push_back(seed->y);
+                }
+            }
+            build_tile(tile_list[index], constraints[index], holes, options.switches);
+        });
+    }
+
+    std::optional<std::uint32_t> TiledLocator::tile_index(Vertex::Point point) const {
+        if (tile_list.empty()) {
+            return std::nullopt;
+        }
+        const Tile& last = tile_list.back();
+        if (point.x < origin_x || point.y < origin_y || point.x > last.x1 || point.y > last.y1) {
+            return std::nullopt;
+        }
+        const std::uint32_t column = std::min<std::uint32_t>((point.x - origin_x) / tile_size, columns - 1);
+        const std::uint32_t row = std::min<std::uint32_t>((point.y - origin_y) / tile_size, rows - 1);
+        return row * columns + column;
+    }
+
+    std::optional<TileLocation> TiledLocator::locate_point(Vertex::Point point) const {
+        const std::optional<std::uint32_t> tile = tile_index(point);
+        if (!tile) {
+            return std::nullopt;
+        }
+        const std::optional<unsigned int> triangle = tile_list[*tile].locator.locate_point(point);
+        if (!triangle) {
+            return std::nullopt;
+        }
+        return TileLocation{ *tile, *triangle };
+    }
+}
@@ -0,0 +1,107 @@
+#include "TriangleManipulator/Topology.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+namespace TriangleManipulator {
+    namespace {
+        struct SideKey {
+            // The side's vertex pair, smaller id in the high half.
+            std::uint64_t key;
+            unsigned int side;
+        };
+    }
+
+    MeshTopology build_topology(const unsigned int* triangles, size_t triangle_count, size_t vertex_count) {
+        MeshTopology topology;
+        const size_t sides = triangle_count * 3;
+        std::vector<SideKey> keys(sides);
+        parallel_chunks(triangle_count, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                for (size_t j = 0; j < 3; j++) {
+                    const std::uint64_t a = triangles[i * 3 + (j + 1) % 3];
+                    const std::uint64_t b = triangles[i * 3 + (j + 2) % 3];
+                    keys[i * 3 + j] = { a < b ? (a << 32) | b : (b << 32) | a, static_cast<unsigned int>(i * 3 + j) };
+                }
+            }
+        });
+        parallel_sort(keys.begin(), keys.end(), [](const SideKey& a, const SideKey& b) {
+            return a.key < b.key || (a.key == b.key && a.side < b.side);
+        });
+
+        // Every run of equal keys is one edge, and the first two sides in a run face each other.
+        topology.neighbors.assign(sides, -1);
+        compact_records(sides, [&](size_t begin, size_t end, std::uint8_t* flags) {
+            for (size_t i = begin; i < end; i++) {
+                flags[i] = i == 0 || keys[i].key != keys[i - 1].key;
+            }
+        }, [&](size_t kept) {
+            topology.edges.resize(kept * 2);
+            topology.edge_sides.resize(kept);
+        }, [&](size_t from, size_t to) {
+            const SideKey& first = keys[from];
+            topology.edges[to * 2] = static_cast<unsigned int>(first.key >> 32);
+            topology.edges[to * 2 + 1] = static_cast<unsigned int>(first.key);
+            topology.edge_sides[to] = first.side;
+            if (from + 1 < sides && keys[from + 1].key == first.key) {
+                const SideKey& second = keys[from + 1];
+                topology.neighbors[first.side] = second.side / 3;
+                topology.neighbors[second.side] = first.side / 3;
+            }
+        });
+
+        // Counting sort of the corners by vertex. Filling races on the cursors, so each vertex's triangles are sorted afterwards.
+        std::vector<unsigned int>& start = topology.vertex_triangle_start;
+        start.assign(vertex_count + 1, 0);
+        parallel_chunks(sides, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                std::atomic_ref<unsigned int>(start[triangles[i] + 1]).fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        for (size_t vertex = 0; vertex < vertex_count; vertex++) {
+            start[vertex + 1] += start[vertex];
+        }
+        std::vector<unsigned int> cursor(start.begin(), start.end() - 1);
+        topology.vertex_triangles.resize(sides);
+        parallel_chunks(sides, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const unsigned int slot = std::atomic_ref<unsigned int>(cursor[triangles[i]]).fetch_add(1, std::memory_order_relaxed);
+                topology.vertex_triangles[slot] = i / 3;
+            }
+        });
+        parallel_chunks(vertex_count, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            for (size_t vertex = begin; vertex < end; vertex++) {
+                std::sort(topology.vertex_triangles.begin() + start[vertex], topology.vertex_triangles.begin() + start[vertex + 1]);
+            }
+        });
+        return topology;
+    }
+
+    MeshTopology build_topology(std::shared_ptr<const triangulateio> mesh) {
+        if (mesh->numberofcorners > 3) {
+            throw std::runtime_error(fmt::format("Topology needs 3 corners per triangle, the mesh has {}", mesh->numberofcorners));
+        }
+        return build_topology(mesh->trianglelist.get(), mesh->numberoftriangles, mesh->numberofpoints);
+    }
+
+    void add_topology(std::shared_ptr<triangulateio> mesh) {
+        const MeshTopology topology = build_topology(mesh);
+        const size_t edges = topology.edge_count();
+        mesh->numberofedges = edges;
+        mesh->edgelist = allocate<int>(edges * 2);
+        mesh->edgemarkerlist = allocate<int>(edges);
+        mesh->normlist = nullptr;
+        int* edge_ptr = mesh->edgelist.get();
+        int* marker_ptr = mesh->edgemarkerlist.get();
+        parallel_chunks(edges, FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+            std::copy(topology.edges.begin() + begin * 2, topology.edges.begin() + end * 2, edge_ptr + begin * 2);
+            for (size_t i = begin; i < end; i++) {
+                marker_ptr[i] = topology.boundary(i);
+            }
+        });
+        mesh->neighborlist = allocate<int>(topology.neighbors.size());
+        std::copy(topology.neighbors.begin(), topology.neighbors.end(), mesh->neighborlist.get());
+    }
+}
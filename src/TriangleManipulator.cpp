@@ -1,6 +1,9 @@
 #include <stdio.h>
 
 #include "TriangleManipulator/TriangleManipulatorTemplates.hpp"
+#include "TriangleManipulator/Parallel.hpp"
+#include "TriangleManipulator/Topology.hpp"
+#include <atomic>
 
 namespace TriangleManipulator {
 
@@ -16,61 +19,242 @@ namespace TriangleManipulator {
     }
 
     /**
-     * @brief Find particular points that match what you want.
+     * @brief Find particular points that match what you want. Kept for callers holding a std::function; lambdas get the template.
+     * One chunk, so the predicate runs on this thread only and its exceptions reach the caller.
      * 
      * @param input 
      * @param output 
      * @param predicate 
      */
     void filter_points(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, std::function<bool(int, REAL, REAL, REAL)> predicate) {
-        int points_found = 0;
-        std::vector<int> found_points = std::vector<int>();
-        unsigned int points = input->numberofpoints;
-        unsigned int attributes = input->numberofpointattributes;
-        bool markers = input->pointmarkerlist != nullptr;
-        REAL* input_point_ptr = input->pointlist.get();
-        REAL* input_point_attribute_ptr = input->pointattributelist.get();
-        int* input_point_marker_ptr = input->pointmarkerlist.get();
-        for (unsigned int i = 0; i < points; i++) {
-            double x = input_point_ptr[2 * i];
-            double y = input_point_ptr[2 * i + 1];
-            if(attributes) {
-                for(unsigned int j = 0; j < attributes; j++) {
-                    double attr = input_point_attribute_ptr[attributes * i + j];
-                    if(predicate(i, x, y, attr)) {
-                        found_points.push_back(i);
-                        points_found++;
-                        break;
-                    }
-                }
-            } else {
-                if(predicate(i, x, y, 0)) {
-                    found_points.push_back(i);
-                    points_found++;
-                }
+        filter_points_by_mask(input, output, point_predicate_mask(*input, predicate), SIZE_MAX);
+    }
+
+    void filter_edges(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, std::function<bool(const int&, const int& , const double&, const double&)> predicate) {
+        filter_edges_by_mask(input, output, edge_predicate_mask(*input, predicate), SIZE_MAX);
+    }
+
+    void filter_points_in_box(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, REAL min_x, REAL min_y, REAL max_x, REAL max_y) {
+        const REAL* point_ptr = input->pointlist.get();
+        filter_points_by_mask(input, output, [=](size_t begin, size_t end, std::uint8_t* flags) {
+            for (size_t i = begin; i < end; i++) {
+                const REAL x = point_ptr[i * 2], y = point_ptr[i * 2 + 1];
+                flags[i] = (x >= min_x) & (x <= max_x) & (y >= min_y) & (y <= max_y);
             }
+        });
+    }
+
+    void filter_points_with_marker(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, int marker) {
+        const int* marker_ptr = input->pointmarkerlist.get();
+        filter_points_by_mask(input, output, [=](size_t begin, size_t end, std::uint8_t* flags) {
+            if (marker_ptr == nullptr) {
+                std::fill(flags + begin, flags + end, 0);
+                return;
+            }
+            for (size_t i = begin; i < end; i++) {
+                flags[i] = marker_ptr[i] == marker;
+            }
+        });
+    }
+
+    void filter_edges_with_marker(std::shared_ptr<triangulateio> input, std::shared_ptr<triangulateio> output, int marker) {
+        const int* marker_ptr = input->edgemarkerlist.get();
+        filter_edges_by_mask(input, output, [=](size_t begin, size_t end, std::uint8_t* flags) {
+            if (marker_ptr == nullptr) {
+                std::fill(flags + begin, flags + end, 0);
+                return;
+            }
+            for (size_t i = begin; i < end; i++) {
+                flags[i] = marker_ptr[i] == marker;
+            }
+        });
+    }
+
+    void compact(std::shared_ptr<const triangulateio> input, std::shared_ptr<triangulateio> output, std::span<const std::uint8_t> keep_points) {
+        // Holding the input's arrays lets output be input: replacing them there doesn't free what is still being read.
+        const triangulateio source = *input;
+        const size_t points = source.numberofpoints;
+        const size_t triangles = source.numberoftriangles;
+        const size_t segments = source.numberofsegments;
+        const size_t edges = source.numberofedges;
+        // 6 for meshes from the o2 switch, whose extra corners are the edge midpoints. Left at 0 by meshes that were filled in by hand.
+        const size_t corners = source.numberofcorners > 0 ? source.numberofcorners : 3;
+        if (!keep_points.empty() && keep_points.size() != points) {
+            throw std::runtime_error(fmt::format("{} point flags given for {} points", keep_points.size(), points));
         }
-        output->numberofpoints = points_found;
-        output->pointlist = trimalloc<REAL>(2 * points_found);
-        if(markers) {
-            output->pointmarkerlist = trimalloc<int>(points_found);
+        const auto kept = [&](auto point) {
+            return size_t(point) < points && (keep_points.empty() || keep_points[point]);
+        };
+        const bool elements = triangles > 0 || segments > 0 || edges > 0;
+
+        // Elements survive when all their corners do, and points survive when something left uses them.
+        std::vector<std::uint8_t> used(points, !elements);
+        std::vector<std::uint8_t> triangle_kept(triangles), segment_kept(segments), edge_kept(edges);
+        const auto mark_elements = [&](const auto* corner_ptr, size_t stride, std::vector<std::uint8_t>& element_kept) {
+            parallel_chunks(element_kept.size(), FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    bool keep = true;
+                    for (size_t j = 0; j < stride; j++) {
+                        // Voronoi edges use -1 for the missing end of a ray.
+                        keep &= corner_ptr[i * stride + j] < 0 || kept(corner_ptr[i * stride + j]);
+                    }
+                    element_kept[i] = keep;
+                    if (keep) {
+                        for (size_t j = 0; j < stride; j++) {
+                            if (corner_ptr[i * stride + j] >= 0) {
+                                std::atomic_ref<std::uint8_t>(used[corner_ptr[i * stride + j]]).store(1, std::memory_order_relaxed);
+                            }
+                        }
+                    }
+                }
+            });
+        };
+        mark_elements(source.trianglelist.get(), corners, triangle_kept);
+        mark_elements(source.segmentlist.get(), 2, segment_kept);
+        mark_elements(source.edgelist.get(), 2, edge_kept);
+        if (!elements && !keep_points.empty()) {
+            used.assign(keep_points.begin(), keep_points.end());
         }
-        if(attributes > 0) {
-            output->pointattributelist = trimalloc<REAL>(attributes * points_found);
+
+        std::vector<unsigned int> point_map(points, -1);
+        {
+            const size_t attributes = source.numberofpointattributes;
+            const REAL* point_ptr = source.pointlist.get();
+            const REAL* attribute_ptr = source.pointattributelist.get();
+            const int* marker_ptr = source.pointmarkerlist.get();
+            REAL* out_point_ptr = nullptr;
+            REAL* out_attribute_ptr = nullptr;
+            int* out_marker_ptr = nullptr;
+            output->numberofpoints = compact_records(points, [&](size_t begin, size_t end, std::uint8_t* flags) {
+                std::copy(used.begin() + begin, used.begin() + end, flags + begin);
+            }, [&](size_t count) {
+                output->numberofpointattributes = attributes;
+                output->pointlist = allocate<REAL>(count * 2);
+                out_point_ptr = output->pointlist.get();
+                output->pointattributelist = attribute_ptr ? allocate<REAL>(count * attributes) : nullptr;
+                out_attribute_ptr = output->pointattributelist.get();
+                output->pointmarkerlist = marker_ptr ? allocate<int>(count) : nullptr;
+                out_marker_ptr = output->pointmarkerlist.get();
+            }, [&](size_t from, size_t to) {
+                point_map[from] = to;
+                out_point_ptr[to * 2] = point_ptr[from * 2];
+                out_point_ptr[to * 2 + 1] = point_ptr[from * 2 + 1];
+                if (attribute_ptr) {
+                    std::copy_n(attribute_ptr + from * attributes, attributes, out_attribute_ptr + to * attributes);
+                }
+                if (marker_ptr) {
+                    out_marker_ptr[to] = marker_ptr[from];
+                }
+            });
         }
-        REAL* output_point_ptr = output->pointlist.get();
-        REAL* output_point_attribute_ptr = output->pointattributelist.get();
-        int* output_point_marker_ptr = output->pointmarkerlist.get();
-        for (int i = 0; i < points_found; i++) {
-            int point = found_points[i];
-            memcpy(output_point_ptr + i * 2, input_point_ptr + point * 2, 2 * sizeof(REAL));
-            if(markers) {
-                output_point_marker_ptr[i] = input_point_marker_ptr[point];
+
+        {
+            const size_t attributes = source.numberoftriangleattributes;
+            const unsigned int* triangle_ptr = source.trianglelist.get();
+            const REAL* attribute_ptr = source.triangleattributelist.get();
+            const REAL* area_ptr = source.trianglearealist.get();
+            const int* neighbor_ptr = source.neighborlist.get();
+            const int* subdomain_ptr = source.subdomainlist.get();
+            unsigned int* out_triangle_ptr = nullptr;
+            REAL* out_attribute_ptr = nullptr;
+            REAL* out_area_ptr = nullptr;
+            int* out_subdomain_ptr = nullptr;
+            std::vector<int> triangle_map(neighbor_ptr ? triangles : 0, -1);
+            std::vector<unsigned int> triangle_origin;
+            output->numberoftriangles = compact_records(triangles, [&](size_t begin, size_t end, std::uint8_t* flags) {
+                std::copy(triangle_kept.begin() + begin, triangle_kept.begin() + end, flags + begin);
+            }, [&](size_t count) {
+                output->numberofcorners = corners;
+                output->numberoftriangleattributes = attributes;
+                output->numberofsubdomains = source.numberofsubdomains;
+                output->trianglelist = triangle_ptr ? allocate<unsigned int>(count * corners) : nullptr;
+                out_triangle_ptr = output->trianglelist.get();
+                output->triangleattributelist = attribute_ptr ? allocate<REAL>(count * attributes) : nullptr;
+                out_attribute_ptr = output->triangleattributelist.get();
+                output->trianglearealist = area_ptr ? allocate<REAL>(count) : nullptr;
+                out_area_ptr = output->trianglearealist.get();
+                output->subdomainlist = subdomain_ptr ? allocate<int>(count) : nullptr;
+                out_subdomain_ptr = output->subdomainlist.get();
+                output->neighborlist = neighbor_ptr ? allocate<int>(count * 3) : nullptr;
+                triangle_origin.resize(neighbor_ptr ? count : 0);
+            }, [&](size_t from, size_t to) {
+                for (size_t j = 0; j < corners; j++) {
+                    out_triangle_ptr[to * corners + j] = point_map[triangle_ptr[from * corners + j]];
+                }
+                if (attribute_ptr) {
+                    std::copy_n(attribute_ptr + from * attributes, attributes, out_attribute_ptr + to * attributes);
+                }
+                if (area_ptr) {
+                    out_area_ptr[to] = area_ptr[from];
+                }
+                if (subdomain_ptr) {
+                    out_subdomain_ptr[to] = subdomain_ptr[from];
+                }
+                if (neighbor_ptr) {
+                    triangle_map[from] = to;
+                    triangle_origin[to] = from;
+                }
+            });
+            // Neighbors need every triangle's new id, so they wait for the first pass to finish.
+            if (neighbor_ptr) {
+                int* out_neighbor_ptr = output->neighborlist.get();
+                parallel_chunks(triangle_origin.size(), FILTER_CHUNK, [&](size_t, size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        for (size_t j = 0; j < 3; j++) {
+                            const int neighbor = neighbor_ptr[triangle_origin[i] * 3 + j];
+                            out_neighbor_ptr[i * 3 + j] = neighbor < 0 ? -1 : triangle_map[neighbor];
+                        }
+                    }
+                });
             }
-            if (attributes) {
-                memcpy(output_point_attribute_ptr + attributes * i, input_point_attribute_ptr + attributes * point, attributes * sizeof(REAL));
+        }
+
+        const auto compact_pairs = [&](size_t count, const std::vector<std::uint8_t>& element_kept, const std::shared_ptr<int[]>& list, const std::shared_ptr<int[]>& markers,
+                                       std::shared_ptr<int[]>& out_list, std::shared_ptr<int[]>& out_markers) {
+            const int* list_ptr = list.get();
+            const int* marker_ptr = markers.get();
+            int* out_list_ptr = nullptr;
+            int* out_marker_ptr = nullptr;
+            return compact_records(count, [&](size_t begin, size_t end, std::uint8_t* flags) {
+                std::copy(element_kept.begin() + begin, element_kept.begin() + end, flags + begin);
+            }, [&](size_t kept) {
+                out_list = list_ptr ? allocate<int>(kept * 2) : nullptr;
+                out_list_ptr = out_list.get();
+                out_markers = marker_ptr ? allocate<int>(kept) : nullptr;
+                out_marker_ptr = out_markers.get();
+            }, [&](size_t from, size_t to) {
+                for (size_t j = 0; j < 2; j++) {
+                    const int point = list_ptr[from * 2 + j];
+                    out_list_ptr[to * 2 + j] = point < 0 ? -1 : int(point_map[point]);
+                }
+                if (marker_ptr) {
+                    out_marker_ptr[to] = marker_ptr[from];
+                }
+            });
+        };
+        output->numberofsegments = compact_pairs(segments, segment_kept, source.segmentlist, source.segmentmarkerlist, output->segmentlist, output->segmentmarkerlist);
+        {
+            // Edge norms only mean something on Voronoi output, which has no triangles, but are carried along all the same.
+            const REAL* norm_ptr = source.normlist.get();
+            output->numberofedges = compact_pairs(edges, edge_kept, source.edgelist, source.edgemarkerlist, output->edgelist, output->edgemarkerlist);
+            if (norm_ptr) {
+                output->normlist = allocate<REAL>(output->numberofedges * 2);
+                REAL* out_norm_ptr = output->normlist.get();
+                for (size_t i = 0, to = 0; i < edges; i++) {
+                    if (edge_kept[i]) {
+                        out_norm_ptr[to * 2] = norm_ptr[i * 2];
+                        out_norm_ptr[to * 2 + 1] = norm_ptr[i * 2 + 1];
+                        to++;
+                    }
+                }
+            } else {
+                output->normlist = nullptr;
             }
         }
+        output->holelist = source.holelist;
+        output->numberofholes = source.numberofholes;
+        output->regionlist = source.regionlist;
+        output->numberofregions = source.numberofregions;
     }
 
     /**
@@ -89,10 +273,10 @@ namespace TriangleManipulator {
         if (points > 0 && in->numberofpoints == 0) {
             in->numberofpoints = points;
             in->numberofpointattributes = point_attributes;
-            in->pointlist = trimalloc<REAL>(points * 2);
-            in->pointattributelist = trimalloc<REAL>(points * point_attributes);
+            in->pointlist = allocate<REAL>(points * 2);
+            in->pointattributelist = allocate<REAL>(points * point_attributes);
             if(point_markers) {
-                in->pointmarkerlist = trimalloc<int>(points);
+                in->pointmarkerlist = allocate<int>(points);
             }
         }
         REAL* point_ptr = in->pointlist.get();
@@ -113,6 +297,89 @@ namespace TriangleManipulator {
         }
     }
 
+    /**
+     * @brief Records formatted by a single worker before its buffer is handed back.
+     */
+    constexpr size_t FORMAT_CHUNK = 1 << 14;
+
+    /**
+     * @brief Format count records in parallel, each worker filling its own buffer, then write the buffers out in order.
+     * 
+     * @param file 
+     * @param count Number of records.
+     * @param bytes_per_record Rough size of a formatted record, used to size the buffers.
+     * @param format_range Called as format_range(buffer, begin, end).
+     */
+    template<typename Formatter>
+    inline void write_records(fmt::v8::ostream& file, size_t count, size_t bytes_per_record, Formatter&& format_range) {
+        std::vector<fmt::memory_buffer> buffers(chunk_count(count, FORMAT_CHUNK));
+        parallel_chunks(count, FORMAT_CHUNK, [&](size_t chunk, size_t begin, size_t end) {
+            fmt::memory_buffer& buffer = buffers[chunk];
+            buffer.reserve((end - begin) * bytes_per_record);
+            format_range(buffer, begin, end);
+        });
+        for (const fmt::memory_buffer& buffer : buffers) {
+            file.print("{}", fmt::string_view(buffer.data(), buffer.size()));
+        }
+    }
+
+    template<bool markers, bool attributes>
+    inline void format_node_records(fmt::memory_buffer& buffer, const REAL* points_ptr, const REAL* attributes_ptr, const int* marker_ptr, unsigned int points_attributes, size_t begin, size_t end) {
+        auto it = std::back_inserter(buffer);
+        for (size_t i = begin; i < end; i++) {
+            it = fmt::format_to(it, "\n{} {} {}", i, points_ptr[i * 2], points_ptr[i * 2 + 1]);
+            if constexpr (attributes) {
+                for (unsigned int j = 0; j < points_attributes; j++) {
+                    it = fmt::format_to(it, " {}", attributes_ptr[i * points_attributes + j]);
+                }
+            }
+            if constexpr (markers) {
+                it = fmt::format_to(it, " {}", marker_ptr[i]);
+            }
+        }
+    }
+
+    template<bool markers>
+    inline void format_segment_records(fmt::memory_buffer& buffer, const int* segments_ptr, const int* markers_ptr, size_t begin, size_t end) {
+        auto it = std::back_inserter(buffer);
+        for (size_t i = begin; i < end; i++) {
+            if constexpr (markers) {
+                it = fmt::format_to(it, "\n{} {} {} {}", i, segments_ptr[i * 2], segments_ptr[i * 2 + 1], markers_ptr[i]);
+            } else {
+                it = fmt::format_to(it, "\n{} {} {}", i, segments_ptr[i * 2], segments_ptr[i * 2 + 1]);
+            }
+        }
+    }
+
+    template<bool attributes>
+    inline void format_ele_records(fmt::memory_buffer& buffer, const unsigned int* triangles_ptr, const REAL* attributes_ptr, unsigned int num_attributes, size_t begin, size_t end) {
+        auto it = std::back_inserter(buffer);
+        for (size_t i = begin; i < end; i++) {
+            it = fmt::format_to(it, "\n{} {} {} {}", i, triangles_ptr[3 * i], triangles_ptr[3 * i + 1], triangles_ptr[3 * i + 2]);
+            if constexpr (attributes) {
+                for (unsigned int j = 0; j < num_attributes; j++) {
+                    it = fmt::format_to(it, " {}", attributes_ptr[i * num_attributes + j]);
+                }
+            }
+        }
+    }
+
+    template<bool markers>
+    inline void format_edge_records(fmt::memory_buffer& buffer, const int* edges_ptr, const REAL* norms_ptr, const int* markers_ptr, size_t begin, size_t end) {
+        auto it = std::back_inserter(buffer);
+        for (size_t i = begin; i < end; i++) {
+            const int p1 = edges_ptr[i * 2];
+            const int p2 = edges_ptr[i * 2 + 1];
+            if (p2 == -1) {
+                it = fmt::format_to(it, "\n{} {} {} {} {}", i, p1, p2, norms_ptr[i * 2], norms_ptr[i * 2 + 1]);
+            } else if constexpr (markers) {
+                it = fmt::format_to(it, "\n {} {} {} {}", i, p1, p2, markers_ptr[i]);
+            } else {
+                it = fmt::format_to(it, "\n {} {} {}", i, p1, p2);
+            }
+        }
+    }
+
     /**
      * @brief Method to write a node section to an output stream.
      * 
@@ -127,26 +394,22 @@ namespace TriangleManipulator {
         const double* attributes_ptr = out->pointattributelist.get();
         const int* marker_ptr = out->pointmarkerlist.get();
         file.print("{} 2 {} {}", points, points_attributes, markers);
-        if (markers) {
-            for (unsigned int i = 0; i < points; i++) {
-                const double p1 = *points_ptr++;
-                const double p2 = *points_ptr++;
-                file.print("\n{} {} {}", i, p1, p2);
-                for (unsigned int j = 0; j < points_attributes; j++) {
-                    file.print(" {}", *attributes_ptr++);
+        const size_t bytes_per_record = 40 + 16 * points_attributes;
+        write_records(file, points, bytes_per_record, [&](fmt::memory_buffer& buffer, size_t begin, size_t end) {
+            if (markers) {
+                if (points_attributes > 0) {
+                    format_node_records<true, true>(buffer, points_ptr, attributes_ptr, marker_ptr, points_attributes, begin, end);
+                } else {
+                    format_node_records<true, false>(buffer, points_ptr, attributes_ptr, marker_ptr, points_attributes, begin, end);
                 }
-                file.print(" {}", *marker_ptr++);
-            }
-        } else {
-            for (unsigned int i = 0; i < points; i++) {
-                const double p1 = *points_ptr++;
-                const double p2 = *points_ptr++;
-                file.print("\n{} {} {}", i, p1, p2);
-                for (unsigned int j = 0; j < points_attributes; j++) {
-                    file.print(" {}", *attributes_ptr++);
+            } else {
+                if (points_attributes > 0) {
+                    format_node_records<false, true>(buffer, points_ptr, attributes_ptr, marker_ptr, points_attributes, begin, end);
+                } else {
+                    format_node_records<false, false>(buffer, points_ptr, attributes_ptr, marker_ptr, points_attributes, begin, end);
                 }
             }
-        }
+        });
     }
 
     /**
@@ -179,26 +442,12 @@ namespace TriangleManipulator {
         const bool markers                                              = reader.read<bool>();
         
         if (points > 0) {
-            in->pointlist = trimalloc<REAL>(points * 2);
-            if (in->numberofpointattributes > 0) {
-                in->pointattributelist = trimalloc<REAL>(points * points_attributes);
-            }
-            if(markers) {
-                in->pointmarkerlist = trimalloc<int>(points);
-            }
-        }
-        
-        double* points_ptr = in->pointlist.get();
-        double* attributes_ptr = in->pointattributelist.get();
-        int* marker_ptr = in->pointmarkerlist.get();
-        
-        if (points > 0) {
-            reader.read_array(points_ptr, points * 2);
+            in->pointlist = reader.read_array<REAL>(points * 2);
             if (points_attributes > 0) {
-                reader.read_array(attributes_ptr, points * points_attributes);
+                in->pointattributelist = reader.read_array<REAL>(points * points_attributes);
             }
             if (markers) {
-                reader.read_array(marker_ptr, points);
+                in->pointmarkerlist = reader.read_array<int>(points);
             }
         }
     }
@@ -230,15 +479,23 @@ namespace TriangleManipulator {
         }
     }
 
+    void read_node_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in) {
+        read_node_section_binary(reader, in);
+    }
+
     void read_node_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
         binary_reader reader(filename.c_str());
-        read_node_section_binary(reader, in);
+        read_node_file_binary(reader, in);
         reader.close();
     }
+
+    void write_node_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out) {
+        write_node_section_binary(writer, out);
+    }
     
     void write_node_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
         binary_writer writer(filename.c_str());
-        write_node_section_binary(writer, out);
+        write_node_file_binary(writer, out);
         writer.close();
     }
 
@@ -256,9 +513,9 @@ namespace TriangleManipulator {
         unsigned int markers = segments_header[1];
         // std::tie(segments, markers) = read_many<int, int>(file);
         in->numberofsegments = segments;
-        in->segmentlist = trimalloc<int>(segments * 2);
+        in->segmentlist = allocate<int>(segments * 2);
         if (markers) {
-            in->segmentmarkerlist = trimalloc<int>(segments);
+            in->segmentmarkerlist = allocate<int>(segments);
         }
         int* segment_ptr = in->segmentlist.get();
         int* segment_marker_ptr = in->segmentmarkerlist.get();
@@ -273,7 +530,7 @@ namespace TriangleManipulator {
         }
         unsigned int holes = read_single<unsigned int>(file);
         in->numberofholes = holes;
-        in->holelist = trimalloc<REAL>(holes * 2);
+        in->holelist = allocate<REAL>(holes * 2);
         REAL* hole_ptr = in->holelist.get();
         for (unsigned int i = 0; i < holes; i++) {
             std::vector<REAL> hole = read_line<REAL>(file);
@@ -296,15 +553,13 @@ namespace TriangleManipulator {
         const int* segments_ptr = out->segmentlist.get();
         const int* markers_ptr = out->segmentmarkerlist.get();
         file.print("\n{} {}", segments, markers);
-        for (unsigned int i = 0; i < segments; i++) {
-            const int s1 = *segments_ptr++;
-            const int s2 = *segments_ptr++;
+        write_records(file, segments, 32, [&](fmt::memory_buffer& buffer, size_t begin, size_t end) {
             if (markers) {
-                file.print("\n{} {} {} {}",  i, s1, s2, markers_ptr[i]);
+                format_segment_records<true>(buffer, segments_ptr, markers_ptr, begin, end);
             } else {
-                file.print("\n{} {} {}", i, s1, s2);
+                format_segment_records<false>(buffer, segments_ptr, markers_ptr, begin, end);
             }
-        }
+        });
         const unsigned int holes = out->numberofholes;
         const REAL* holes_ptr = out->holelist.get();
         file.print("\n{}", holes);
@@ -316,40 +571,33 @@ namespace TriangleManipulator {
         file.close();
     }
 
-    void read_poly_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
-        binary_reader reader(filename.c_str());
+    void read_poly_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in) {
         const unsigned int segments = reader.read<unsigned int>();
         const unsigned int holes = reader.read<unsigned int>();
         const unsigned int segment_markers = reader.read<unsigned int>();
         read_node_section_binary(reader, in);
         
         in->numberofsegments = segments;
-        in->segmentlist = trimalloc<int>(segments * 2);
-        if (segment_markers) {
-            in->segmentmarkerlist = trimalloc<int>(segments);
-        }
-        
         in->numberofholes = holes;
-        in->holelist = trimalloc<REAL>(holes * 2);
-        
-        int* segment_ptr = in->segmentlist.get();
-        int* markers_ptr = in->segmentmarkerlist.get();
-        REAL* holes_ptr = in->holelist.get();
         if (segments > 0) {
-            reader.read_array(segment_ptr, segments * 2);
+            in->segmentlist = reader.read_array<int>(segments * 2);
             
             if (segment_markers) {
-                reader.read_array(markers_ptr, segments);
+                in->segmentmarkerlist = reader.read_array<int>(segments);
             }
         }
         if (holes > 0) {
-            reader.read_array(holes_ptr, holes * 2);
+            in->holelist = reader.read_array<REAL>(holes * 2);
         }
+    }
+
+    void read_poly_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
+        binary_reader reader(filename.c_str());
+        read_poly_file_binary(reader, in);
         reader.close();
     }
     
-    void write_poly_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
-        binary_writer writer(filename.c_str());
+    void write_poly_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out) {
         const unsigned int segments = out->numberofsegments;
         const unsigned int markers  = out->segmentmarkerlist != nullptr;
         const unsigned int holes = out->numberofholes;
@@ -376,7 +624,11 @@ namespace TriangleManipulator {
         if (holes > 0) {
             writer.write_array(holes_ptr, holes * 2);
         }
-        
+    }
+
+    void write_poly_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
+        binary_writer writer(filename.c_str());
+        write_poly_file_binary(writer, out);
         writer.close();
     }
 
@@ -393,11 +645,11 @@ namespace TriangleManipulator {
         const int markers = header[1];
         bool is_voronoi = false;
         if (in->numberofedges > 0) {
-            in->edgelist = trimalloc<int>(in->numberofedges * 2);
+            in->edgelist = allocate<int>(in->numberofedges * 2);
             double* norm_ptr;
             int* edge_ptr = in->edgelist.get();
             if (markers) {
-                in->edgemarkerlist = trimalloc<int>(in->numberofedges);
+                in->edgemarkerlist = allocate<int>(in->numberofedges);
             }
             int* edge_marker_ptr = in->edgemarkerlist.get();
             for (unsigned int i = 0; i < in->numberofedges; i++) {
@@ -406,7 +658,7 @@ namespace TriangleManipulator {
                 int p2 = edge_ptr[i* 2 + 1] =line[2];
                 if (p2 == -1) {
                     if (!is_voronoi) {
-                        in->normlist = trimalloc<double>(in->numberofedges * 2);
+                        in->normlist = allocate<double>(in->numberofedges * 2);
                         norm_ptr = in->normlist.get();
                         is_voronoi = true;
                     }
@@ -436,25 +688,17 @@ namespace TriangleManipulator {
         const REAL* norms_ptr = out->normlist.get();
         const int* markers_ptr = out->edgemarkerlist.get();
         file.print("{} {}", edges, markers);
-        for (unsigned int i = 0; i < edges; i++) {
-            int p1 = *edges_ptr++;
-            int p2 = *edges_ptr++;
-            if (p2 == -1) {
-                file.print("\n{} {} {} {} {}", i, p1, p2, norms_ptr[i * 2], norms_ptr[i * 2 + 1]);
+        write_records(file, edges, 32, [&](fmt::memory_buffer& buffer, size_t begin, size_t end) {
+            if (markers) {
+                format_edge_records<true>(buffer, edges_ptr, norms_ptr, markers_ptr, begin, end);
             } else {
-                if (markers) {
-                    file.print("\n {} {} {} {}", i, p1, p2, markers_ptr[i]);
-                } else {
-                    
-                    file.print("\n {} {} {}", i, p1, p2);
-                }
+                format_edge_records<false>(buffer, edges_ptr, norms_ptr, markers_ptr, begin, end);
             }
-        }
+        });
         file.close();
     }
 
-    void read_edge_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
-        binary_reader reader(filename.c_str());
+    void read_edge_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in) {
         const unsigned int edges = reader.read<unsigned int>();
         const bool markers = reader.read<bool>();
         const bool voronoi = reader.read<bool>();
@@ -463,17 +707,21 @@ namespace TriangleManipulator {
         if (voronoi) {
             in->normlist = reader.read_array<double>(edges * 2);
         } else if (markers) {
-            in->normlist = reader.read_array<double>(edges);
+            in->edgemarkerlist = reader.read_array<int>(edges);
         }
+    }
+
+    void read_edge_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
+        binary_reader reader(filename.c_str());
+        read_edge_file_binary(reader, in);
         reader.close();
     }
     
-    void write_edge_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
-        binary_writer writer = binary_writer(filename.c_str());
+    void write_edge_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out) {
         const unsigned int edges = out->numberofedges;
         const bool markers = (bool) out->edgemarkerlist;
         const bool voronoi = (bool) out->normlist;
-        writer.write(out->numberofedges);
+        writer.write(edges);
         writer.write(markers);
         writer.write(voronoi);
         writer.write_array(out->edgelist, edges * 2);
@@ -482,6 +730,11 @@ namespace TriangleManipulator {
         } else if (markers) {
             writer.write_array(out->edgemarkerlist, edges);
         }
+    }
+
+    void write_edge_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
+        binary_writer writer(filename.c_str());
+        write_edge_file_binary(writer, out);
         writer.close();
     }
 
@@ -491,9 +744,9 @@ namespace TriangleManipulator {
         in->numberoftriangles = header[0];
         in->numberoftriangleattributes = header[2];
         
-        in->trianglelist = trimalloc<unsigned int>(in->numberoftriangles * 3);
+        in->trianglelist = allocate<unsigned int>(in->numberoftriangles * 3);
         if (in->numberoftriangleattributes > 0) {
-            in->triangleattributelist = trimalloc<REAL>(in->numberoftriangles * in->numberoftriangleattributes);
+            in->triangleattributelist = allocate<REAL>(in->numberoftriangles * in->numberoftriangleattributes);
         }
         unsigned int* triangles_ptr = in->trianglelist.get();
         REAL* attributes_ptr = in->triangleattributelist.get();
@@ -516,83 +769,108 @@ namespace TriangleManipulator {
         const unsigned int* triangles_ptr = out->trianglelist.get();
         const REAL* attributes_ptr = out->triangleattributelist.get();
         file.print("{} 3 {}", triangles, num_attributes);
-        for (unsigned int i = 0; i < triangles; i++) {
-            file.print("\n{} {} {} {}", i, triangles_ptr[3 * i], triangles_ptr[3 * i + 1], triangles_ptr[3 * i + 2]);
-            for (unsigned int j = 0; j < num_attributes; j++) {
-                file.print(" {}", *attributes_ptr++);
+        write_records(file, triangles, 40 + 16 * num_attributes, [&](fmt::memory_buffer& buffer, size_t begin, size_t end) {
+            if (num_attributes > 0) {
+                format_ele_records<true>(buffer, triangles_ptr, attributes_ptr, num_attributes, begin, end);
+            } else {
+                format_ele_records<false>(buffer, triangles_ptr, attributes_ptr, num_attributes, begin, end);
             }
-        }
+        });
         file.close();
     }
 
-    void read_ele_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
-        binary_reader reader(filename.c_str());
+    void read_ele_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in) {
         const unsigned int triangles = reader.read<unsigned int>();
         const unsigned int num_attributes = reader.read<unsigned int>();
         in->numberoftriangles = triangles;
         in->numberoftriangleattributes = num_attributes;
 
-        in->trianglelist = trimalloc<unsigned int>(in->numberoftriangles * 3);
-        if (in->numberoftriangleattributes > 0) {
-            in->triangleattributelist = trimalloc<REAL>(in->numberoftriangles * num_attributes);
-        }
-        unsigned int* triangles_ptr = in->trianglelist.get();
-        REAL* attributes_ptr = in->triangleattributelist.get();
-        reader.read_array(triangles_ptr, triangles * 3);
-        
+        in->trianglelist = reader.read_array<unsigned int>(triangles * 3);
         if (num_attributes > 0) {
-            reader.read_array(attributes_ptr, triangles * num_attributes);
+            in->triangleattributelist = reader.read_array<REAL>(triangles * num_attributes);
         }
+    }
+
+    void read_ele_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
+        binary_reader reader(filename.c_str());
+        read_ele_file_binary(reader, in);
         reader.close();
     }
 
-    void write_ele_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
-        binary_writer writer(filename.c_str());
+    void write_ele_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out) {
         const unsigned int triangles = out->numberoftriangles;
         const unsigned int num_attributes = out->numberoftriangleattributes;
         writer.write(triangles);
         writer.write(num_attributes);
         writer.write_array(out->trianglelist, triangles * 3);
         writer.write_array(out->triangleattributelist, triangles * num_attributes);
-        writer.close();
     }
 
-     void write_neigh_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
+    void write_ele_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
         binary_writer writer(filename.c_str());
+        write_ele_file_binary(writer, out);
+        writer.close();
+    }
+
+    void write_neigh_file_binary(binary_writer& writer, std::shared_ptr<const triangulateio> out) {
         const unsigned int triangles = out->numberoftriangles;
         writer.write(triangles);
+        if (out->neighborlist == nullptr) {
+            writer.write_array(build_topology(out).neighbors.data(), triangles * 3);
+            return;
+        }
         writer.write_array(out->neighborlist, triangles * 3);
+    }
+
+    void write_neigh_file_binary(std::string filename, std::shared_ptr<const triangulateio> out) {
+        binary_writer writer(filename.c_str());
+        write_neigh_file_binary(writer, out);
         writer.close();
-     }
+    }
 
-     void read_neigh_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
-        binary_reader reader(filename.c_str());
+    void read_neigh_file_binary(binary_reader& reader, std::shared_ptr<triangulateio> in) {
         const unsigned int triangles = reader.read<unsigned int>();
         in->numberoftriangles = triangles;
 
         in->neighborlist = reader.read_array<int>(triangles * 3);
+    }
+
+    void read_neigh_file_binary(std::string filename, std::shared_ptr<triangulateio> in) {
+        binary_reader reader(filename.c_str());
+        read_neigh_file_binary(reader, in);
         reader.close();
     }
 
     void write_neigh_file(std::string filename, std::shared_ptr<triangulateio> out) {
         fmt::v8::ostream file = fmt::output_file(filename.c_str());
         const unsigned int triangles = out->numberoftriangles;
-        // const int* neighbors_ptr = out->neighborlist.get();
-        file.print("{} 3\n", triangles);
-        for (unsigned int i = 0; i < triangles; i++) {
-            file.print("{} {} {} {}\n", i, out->neighborlist[3 * i], out->neighborlist[3 * i + 1], out->neighborlist[3 * i + 2]);
+        // Meshes Triangle wasn't asked to find neighbors for get them derived here.
+        std::vector<int> derived;
+        if (out->neighborlist == nullptr) {
+            derived = build_topology(out).neighbors;
         }
+        const int* neighbors_ptr = out->neighborlist ? out->neighborlist.get() : derived.data();
+        file.print("{} 3\n", triangles);
+        write_records(file, triangles, 40, [&](fmt::memory_buffer& buffer, size_t begin, size_t end) {
+            auto it = std::back_inserter(buffer);
+            for (size_t i = begin; i < end; i++) {
+                it = fmt::format_to(it, "{} {} {} {}\n", i, neighbors_ptr[3 * i], neighbors_ptr[3 * i + 1], neighbors_ptr[3 * i + 2]);
+            }
+        });
         file.close();
     }
 
-    void write_part_file(std::string filename, std::shared_ptr<triangulateio> out) {
+    void write_part_file(std::string filename, std::shared_ptr<const triangulateio> out) {
         fmt::v8::ostream file = fmt::output_file(filename.c_str());
         const unsigned int triangles = out->numberoftriangles;
         const int* subdomain_ptr = out->subdomainlist.get();
         file.print("{} {}\n", triangles, out->numberofsubdomains);
-        for (unsigned int i = 0; i < triangles; i++) {
-            file.print("{} {}\n", i, *subdomain_ptr++);
-        }
+        write_records(file, triangles, 16, [&](fmt::memory_buffer& buffer, size_t begin, size_t end) {
+            auto it = std::back_inserter(buffer);
+            for (size_t i = begin; i < end; i++) {
+                it = fmt::format_to(it, "{} {}\n", i, subdomain_ptr[i]);
+            }
+        });
         file.close();
     }
 
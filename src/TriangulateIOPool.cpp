@@ -0,0 +1,134 @@
+#include "TriangleManipulator/TriangulateIOPool.hpp"
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace TriangleManipulator {
+    namespace {
+        // The smallest size class is 64 bytes, a cache line.
+        constexpr unsigned int MIN_CLASS = 6;
+        constexpr unsigned int CLASSES = 64;
+        constexpr std::align_val_t BLOCK_ALIGNMENT{ 64 };
+
+        thread_local TriangulateIOPool* current_pool = nullptr;
+    }
+
+    struct TriangulateIOPool::State {
+        mutable std::mutex mutex;
+        size_t max_retained_bytes;
+        size_t retained_bytes = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+        std::vector<void*> free_blocks[CLASSES];
+        std::vector<triangulateio*> free_shells;
+        State(size_t max_retained_bytes) : max_retained_bytes(max_retained_bytes) {}
+        ~State() {
+            for (unsigned int size_class = 0; size_class < CLASSES; size_class++) {
+                for (void* block : free_blocks[size_class]) {
+                    ::operator delete(block, BLOCK_ALIGNMENT);
+                }
+            }
+            for (triangulateio* shell : free_shells) {
+                delete shell;
+            }
+        }
+    };
+
+    TriangulateIOPool::TriangulateIOPool(size_t max_retained_bytes) : state(std::make_shared<State>(max_retained_bytes)) {}
+
+    void* TriangulateIOPool::acquire(size_t bytes, unsigned int& size_class) {
+        size_class = std::max<unsigned int>(MIN_CLASS, std::bit_width(std::max<size_t>(bytes, 1) - 1));
+        {
+            std::lock_guard lock(state->mutex);
+            std::vector<void*>& blocks = state->free_blocks[size_class];
+            if (!blocks.empty()) {
+                void* block = blocks.back();
+                blocks.pop_back();
+                state->retained_bytes -= size_t(1) << size_class;
+                state->hits++;
+                return block;
+            }
+            state->misses++;
+        }
+        return ::operator new(size_t(1) << size_class, BLOCK_ALIGNMENT);
+    }
+
+    void TriangulateIOPool::release(const std::weak_ptr<State>& weak_state, void* block, unsigned int size_class) {
+        if (std::shared_ptr<State> state = weak_state.lock()) {
+            std::lock_guard lock(state->mutex);
+            if (state->retained_bytes + (size_t(1) << size_class) <= state->max_retained_bytes) {
+                state->free_blocks[size_class].push_back(block);
+                state->retained_bytes += size_t(1) << size_class;
+                return;
+            }
+        }
+        ::operator delete(block, BLOCK_ALIGNMENT);
+    }
+
+    std::shared_ptr<triangulateio> TriangulateIOPool::create_instance() {
+        triangulateio* shell = nullptr;
+        {
+            std::lock_guard lock(state->mutex);
+            if (!state->free_shells.empty()) {
+                shell = state->free_shells.back();
+                state->free_shells.pop_back();
+                state->hits++;
+            } else {
+                state->misses++;
+            }
+        }
+        if (shell == nullptr) {
+            shell = new triangulateio();
+        }
+        return std::shared_ptr<triangulateio>(shell, [weak_state = std::weak_ptr<State>(state)](triangulateio* shell) {
+            // Drops the arrays, which sends pooled ones back on their own, and zeroes the counts for the next user.
+            *shell = triangulateio();
+            if (std::shared_ptr<State> state = weak_state.lock()) {
+                std::lock_guard lock(state->mutex);
+                state->free_shells.push_back(shell);
+                return;
+            }
+            delete shell;
+        });
+    }
+
+    void TriangulateIOPool::trim() {
+        std::vector<void*> blocks[CLASSES];
+        std::vector<triangulateio*> shells;
+        {
+            std::lock_guard lock(state->mutex);
+            for (unsigned int size_class = 0; size_class < CLASSES; size_class++) {
+                blocks[size_class].swap(state->free_blocks[size_class]);
+            }
+            shells.swap(state->free_shells);
+            state->retained_bytes = 0;
+        }
+        for (std::vector<void*>& list : blocks) {
+            for (void* block : list) {
+                ::operator delete(block, BLOCK_ALIGNMENT);
+            }
+        }
+        for (triangulateio* shell : shells) {
+            delete shell;
+        }
+    }
+
+    TriangulateIOPool::Stats TriangulateIOPool::stats() const {
+        std::lock_guard lock(state->mutex);
+        return { state->hits, state->misses, state->retained_bytes };
+    }
+
+    TriangulateIOPool::Scope::Scope(TriangulateIOPool& pool) : previous(current_pool) {
+        current_pool = &pool;
+    }
+
+    TriangulateIOPool::Scope::~Scope() {
+        current_pool = previous;
+    }
+
+    TriangulateIOPool* TriangulateIOPool::current() {
+        return current_pool;
+    }
+}